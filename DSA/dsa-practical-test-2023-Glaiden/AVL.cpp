@@ -11,81 +11,233 @@
 #include "BST.h"
 
 
-// function that calls add()
-template <typename T>
-void AVL<T>::add(const T& value) {
-    PathStack pathNodes;
-    add_(this->rootRef(), value, pathNodes);
-    
+// function that calls add_()
+template <typename T, typename Links>
+void AVL<T, Links>::add(const T& value) {
+    add_(this->rootRef(), value, this->path_);
 }
 
 // function that calls remove_()
-template <typename T>
-void AVL<T>::remove(const T& value) {
-    PathStack pathNodes;
-    remove_(this->rootRef(),value,pathNodes);
+template <typename T, typename Links>
+void AVL<T, Links>::remove(const T& value) {
+    remove_(this->rootRef(), value, this->path_);
 }
 //adding new node to hold input value 
-template <typename T>
-void AVL<T>::add_(typename BST<T>::BinTree& tree, const T& value, PathStack& pathNodes)
+// - walks down iteratively, then fixes the path bottom-up
+template <typename T, typename Links>
+void AVL<T, Links>::add_(typename BST<T, Links>::BinTree& tree, const T& value, PathStack& pathNodes)
 {
-    //if tree is empty make node to hold value
-    if (!tree) {
-        tree = BST<T>::makeNode(value);
-    } else if (value < tree->data) { // if input value is less than current node data 
-        pathNodes.push(tree);  // Push the parent node onto the stack
-        add_(tree->left, value, pathNodes); // recursively call add_() but use left child node of current node as input to hold value
-    } else {
-        pathNodes.push(tree);  // Push the parent node onto the stack
-        add_(tree->right, value, pathNodes);
+    pathNodes.clear();
+    typename BST<T, Links>::BinTree* link = &tree;
+    while (*link) {
+        BST<T, Links>::unshare_(*link); // it may be rotated on the way back
+        pathNodes.push_back(link); // Push the parent link onto the stack
+        // values less than the current node go left, the rest go right
+        link = value < (*link)->data ? &(*link)->left : &(*link)->right;
     }
-    balancenode(tree); // balance the tree using current node at reference
+    //the empty link found gets the node to hold value
+    *link = BST<T, Links>::makeNode(value);
 
+    // after an insert, one rotation restores the balance
+    balance(pathNodes, true);
 }
 // removes node holding a ccertain input value
-template <typename T>
-void AVL<T>::remove_(typename BST<T>::BinTree& tree, const T& value, PathStack& pathNodes) {
-    pathNodes.push(tree); // push parent node into stack
-    BST<T>::remove(value); // calls remove() from BST 
-    pathNodes.pop();  // Pop the parent node
-    tree->height_ = 1 + std::max(BST<T>::treeHeight(tree->left), BST<T>::treeHeight(tree->right)); // update height
-    balancenode(tree); // balance the tree using current node at reference
-
-}
-//balance function that access stack to balance(does not work)
-template <typename T>
-void AVL<T>::balance(PathStack& pathNodes, bool stopAtFirst) {
-    bool balanced = false;
-    while (!pathNodes.empty()) {
-        typename BST<T>::BinTree node = pathNodes.top();
-        pathNodes.pop();
+// - every node on the path is rebalanced on the way back up, not just the root
+template <typename T, typename Links>
+void AVL<T, Links>::remove_(typename BST<T, Links>::BinTree& tree, const T& value, PathStack& pathNodes) {
+    BST<T, Links>::findPath_(tree, value, pathNodes);
+    if (!*pathNodes.back()) {
+        throw BSTException(BSTException::E_NOT_FOUND, "Value to remove not found in the tree");
+    }
+    BST<T, Links>::unlinkPath_(pathNodes);
+    balance(pathNodes);
+}
+// moves the values less than key into left and the rest into right
+template <typename T, typename Links>
+void AVL<T, Links>::split(const T& key, AVL& left, AVL& right) {
+    BST<T, Links>::split(key, left, right);
+}
 
-        balancenode(node);
-        if (stopAtFirst && balanced) break;
+// replaces the contents with the values of left followed by right
+template <typename T, typename Links>
+void AVL<T, Links>::join(AVL& left, AVL& right) {
+    BST<T, Links>::join(left, right);
+}
+
+// joins two AVL subtrees with a node in between
+// - the shorter subtree is hung off the spine of the taller one where the
+//   heights meet, then only that spine needs rebalancing: O(height difference)
+template <typename T, typename Links>
+typename BST<T, Links>::BinTree AVL<T, Links>::join3_(typename BST<T, Links>::BinTree left, typename BST<T, Links>::BinTree node,
+                                        typename BST<T, Links>::BinTree right) {
+    int leftHeight = BST<T, Links>::height_(left);
+    int rightHeight = BST<T, Links>::height_(right);
+    if (std::abs(leftHeight - rightHeight) <= 1) {
+        return BST<T, Links>::join3_(left, node, right);
+    }
+
+    // go down the right spine of a taller left tree (or the left spine of a taller right tree)
+    bool leftTaller = leftHeight > rightHeight;
+    typename BST<T, Links>::BinTree root = leftTaller ? left : right;
+    int shorter = leftTaller ? rightHeight : leftHeight;
+    PathStack pathNodes;
+    typename BST<T, Links>::BinTree* link = &root;
+    while (BST<T, Links>::height_(*link) > shorter + 1) {
+        BST<T, Links>::unshare_(*link);
+        pathNodes.push_back(link);
+        link = leftTaller ? &(*link)->right : &(*link)->left;
+    }
+    *link = leftTaller ? BST<T, Links>::join3_(*link, node, right) : BST<T, Links>::join3_(left, node, *link);
+    balance(pathNodes);
+    return root;
+}
+
+// adds the values of other that are not in this tree yet
+template <typename T, typename Links>
+void AVL<T, Links>::unionWith(AVL& other) {
+    setOperation(SET_UNION, other);
+}
+
+// keeps only the values that are also in other
+template <typename T, typename Links>
+void AVL<T, Links>::intersectWith(AVL& other) {
+    setOperation(SET_INTERSECTION, other);
+}
+
+// removes the values that are in other
+template <typename T, typename Links>
+void AVL<T, Links>::differenceWith(AVL& other) {
+    setOperation(SET_DIFFERENCE, other);
+}
+
+// runs a set operation with other, which ends up empty
+template <typename T, typename Links>
+void AVL<T, Links>::setOperation(SetOperation op, AVL& other) {
+    if (&other == this) {
+        if (op == SET_DIFFERENCE) {
+            this->clear();
+        }
+        return;
+    }
+    typename BST<T, Links>::BinTree b = this->takeNodes_(other);
+
+    // enough parallel levels for about two tasks per core, unless shared
+    // nodes may have to be copied (the allocator is not thread safe)
+    unsigned depth = 1;
+    for (unsigned tasks = std::max(1u, std::thread::hardware_concurrency()); tasks > 1; tasks /= 2) {
+        ++depth;
+    }
+    if (this->copyOnWrite()) {
+        depth = 0;
+    }
+
+    std::vector<typename BST<T, Links>::BinTree> garbage;
+    this->rootRef() = setOperation_(op, this->rootRef(), b, garbage, depth);
+    for (typename BST<T, Links>::BinTree tree : garbage) {
+        BST<T, Links>::clear_(tree);
+    }
+}
+
+// recursive step of a set operation: split b by a's root, combine the halves, then join
+template <typename T, typename Links>
+typename BST<T, Links>::BinTree AVL<T, Links>::setOperation_(SetOperation op, typename BST<T, Links>::BinTree a, typename BST<T, Links>::BinTree b,
+                                               std::vector<typename BST<T, Links>::BinTree>& garbage, unsigned depth) {
+    if (!a || !b) {
+        if (op == SET_UNION) {
+            return a ? a : b;
+        }
+        if (b) {
+            garbage.push_back(b); // nothing left in a to match or remove
+        }
+        if (a && op == SET_INTERSECTION) {
+            garbage.push_back(a);
+            return nullptr;
+        }
+        return a;
+    }
+    bool parallel = depth > 0 && BST<T, Links>::size_(a) + BST<T, Links>::size_(b) > PARALLEL_CUTOFF;
 
-        if (!balanced && std::abs(getBalance(node)) > 1) {
+    // b splits into the values below, equal to and above a's root
+    BST<T, Links>::unshare_(a); // a's root gets relinked
+    typename BST<T, Links>::BinTree node = a;
+    typename BST<T, Links>::BinTree bLeft, bNotLess, bEqual, bRight;
+    BST<T, Links>::split_(b, node->data, false, bLeft, bNotLess);
+    BST<T, Links>::split_(bNotLess, node->data, true, bEqual, bRight);
+    bool found = bEqual != nullptr;
+    if (found) {
+        garbage.push_back(bEqual);
+    }
+
+    // the two halves share no nodes, so they can run side by side
+    typename BST<T, Links>::BinTree left, right;
+    if (parallel) {
+        std::vector<typename BST<T, Links>::BinTree> leftGarbage;
+        std::future<typename BST<T, Links>::BinTree> task = std::async(std::launch::async | std::launch::deferred, [&]() {
+            return setOperation_(op, node->left, bLeft, leftGarbage, depth - 1);
+        });
+        right = setOperation_(op, node->right, bRight, garbage, depth - 1);
+        left = task.get();
+        garbage.insert(garbage.end(), leftGarbage.begin(), leftGarbage.end());
+    } else {
+        left = setOperation_(op, node->left, bLeft, garbage, depth);
+        right = setOperation_(op, node->right, bRight, garbage, depth);
+    }
+
+    // a's root stays unless it is dropped by the intersection or the difference
+    bool keep = op == SET_UNION || (op == SET_INTERSECTION ? found : !found);
+    if (keep) {
+        return join3_(left, node, right);
+    }
+    node->left = node->right = nullptr;
+    garbage.push_back(node);
+    return BST<T, Links>::join2_(left, right);
+}
+
+// after a node below changed, the path needs rebalancing, not just its stats
+template <typename T, typename Links>
+void AVL<T, Links>::fixPath_(PathStack& path) {
+    balance(path);
+}
+
+//balance function that access the stack of links bottom-up
+template <typename T, typename Links>
+void AVL<T, Links>::balance(PathStack& pathNodes, bool stopAtFirst) {
+    bool balanced = false;
+    while (!pathNodes.empty()) {
+        typename BST<T, Links>::BinTree& node = *pathNodes.back();
+        pathNodes.pop_back();
+        if (!node) {
+            continue; // the removed node's link may now be empty
+        }
+        if (stopAtFirst && balanced) {
+            BST<T, Links>::updateStats(node); // heights above are unchanged, counts are not
+            continue;
+        }
+        if (std::abs(getBalance(node)) > 1) {
             balanced = true;
         }
+        balancenode(node);
     }
 }
 
 //balance function that determine rotation based on balancefactor
-template <typename T>
-void AVL<T>::balancenode(typename BST<T>::BinTree& tree) {
-        tree->height_ = 1 + std::max(BST<T>::treeHeight(tree->left), BST<T>::treeHeight(tree->right));
+// - only reads the cached heights, so it is O(1) per node
+template <typename T, typename Links>
+void AVL<T, Links>::balancenode(typename BST<T, Links>::BinTree& tree) {
+        BST<T, Links>::updateStats(tree); // children are already up to date
 
         // Calculate the balance factor
-        int balanceFactor = BST<T>::treeHeight(tree->left) - BST<T>::treeHeight(tree->right);
+        int balanceFactor = getBalance(tree);
 
         // Perform rotations if necessary
         if (balanceFactor > 1) {
-            if (BST<T>::treeHeight(tree->left->left) >= BST<T>::treeHeight(tree->left->right)) {
+            if (getBalance(tree->left) >= 0) {
                 rotateRight(tree);
             } else {
                 rotateLeftRight(tree);
             }
         } else if (balanceFactor < -1) {
-            if (BST<T>::treeHeight(tree->right->right) >= BST<T>::treeHeight(tree->right->left)) {
+            if (getBalance(tree->right) <= 0) {
                 rotateLeft(tree);
             } else {
                 rotateRightLeft(tree);
@@ -94,77 +246,89 @@ void AVL<T>::balancenode(typename BST<T>::BinTree& tree) {
     }
 
 // Utility function to get the balance factor of the node
-template <typename T>
-int AVL<T>::getBalance(typename BST<T>::BinTree N) {
+template <typename T, typename Links>
+int AVL<T, Links>::getBalance(typename BST<T, Links>::BinTree N) {
     if (N == nullptr)
         return 0;
-    return BST<T>::treeHeight(N->left) - BST<T>::treeHeight(N->right);
+    return BST<T, Links>::height_(N->left) - BST<T, Links>::height_(N->right);
 }
 
 
 
-template <typename T>
-void AVL<T>::rotateLeft(typename BST<T>::BinTree& tree) {
+template <typename T, typename Links>
+void AVL<T, Links>::rotateLeft(typename BST<T, Links>::BinTree& tree) {
     if (!tree || !tree->right) {
         return; // Nothing to rotate
     }
+    // both nodes get relinked, so they must be ours alone
+    BST<T, Links>::unshare_(tree);
+    BST<T, Links>::unshare_(tree->right);
     // Create a new root node, set its left child to the current root,
     // and update the current root's right child.
-    typename BST<T>::BinTree newRoot = tree->right;
+    typename BST<T, Links>::BinTree newRoot = tree->right;
     tree->right = newRoot->left;
     newRoot->left = tree;
-
-    // Update the height of tree and newRoot.
-    tree->height_ = 1 + std::max(BST<T>::treeHeight(tree->left), BST<T>::treeHeight(tree->right));
-    newRoot->height_ = 1 + std::max(BST<T>::treeHeight(newRoot->left), BST<T>::treeHeight(newRoot->right));
+    // Update the count and height of tree and newRoot.
+    BST<T, Links>::updateStats(tree); // bottom-up: tree is now below newRoot
+    BST<T, Links>::updateStats(newRoot);
 
     tree = newRoot; // Update the root.
 }
-template <typename T>
-void AVL<T>::rotateRight(typename BST<T>::BinTree& tree) {
-    typename BST<T>::BinTree leftSubtree = tree->left;
+template <typename T, typename Links>
+void AVL<T, Links>::rotateRight(typename BST<T, Links>::BinTree& tree) {
+    BST<T, Links>::unshare_(tree);
+    BST<T, Links>::unshare_(tree->left);
+    typename BST<T, Links>::BinTree leftSubtree = tree->left;
     tree->left = leftSubtree->right;
     leftSubtree->right = tree;
-    BST<T>::treeHeight(tree);
-    BST<T>::treeHeight(leftSubtree);
+    BST<T, Links>::updateStats(tree);
+    BST<T, Links>::updateStats(leftSubtree);
     tree = leftSubtree;
 }
 
-template <typename T>
-void AVL<T>::rotateLeftRight(typename BST<T>::BinTree& tree) {
+template <typename T, typename Links>
+void AVL<T, Links>::rotateLeftRight(typename BST<T, Links>::BinTree& tree) {
     rotateLeft(tree->left);
     rotateRight(tree);
 }
 
-template <typename T>
-void AVL<T>::rotateRightLeft(typename BST<T>::BinTree& tree) {
+template <typename T, typename Links>
+void AVL<T, Links>::rotateRightLeft(typename BST<T, Links>::BinTree& tree) {
     rotateRight(tree->right);
     rotateLeft(tree);
 }
 
-template <typename T>
-std::stringstream AVL<T>::printInorder() const {
+template <typename T, typename Links>
+std::stringstream AVL<T, Links>::printInorder() const {
     std::stringstream ss;
     printInorder_(this->root(), ss);
     return ss;
 }
 
-template <typename T>
-void AVL<T>::printInorder_(const typename BST<T>::BinTree& tree, std::stringstream& ss) const {
-    if (tree) {
-        printInorder_(tree->left, ss);
-        ss << tree->data << " ";
-        printInorder_(tree->right, ss);
+template <typename T, typename Links>
+void AVL<T, Links>::printInorder_(const typename BST<T, Links>::BinTree& tree, std::stringstream& ss) const {
+    // explicit stack of the nodes whose left subtree is being printed
+    std::vector<typename BST<T, Links>::BinTree> stack;
+    typename BST<T, Links>::BinTree node = tree;
+    while (node || !stack.empty()) {
+        while (node) {
+            stack.push_back(node);
+            node = node->left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        ss << node->data << " ";
+        node = node->right;
     }
 }
 
 
-template <typename T>
-bool AVL<T>::isBalanced(const typename BST<T>::BinTree& tree) const {
+template <typename T, typename Links>
+bool AVL<T, Links>::isBalanced(const typename BST<T, Links>::BinTree& tree) const {
     if (!tree) return true; // A nullptr tree is balanced
     
-    int leftHeight = tree->left ? tree->left->height_ : 0;
-    int rightHeight = tree->right ? tree->right->height_ : 0;
+    int leftHeight = BST<T, Links>::height_(tree->left);
+    int rightHeight = BST<T, Links>::height_(tree->right);
     
     return abs(leftHeight - rightHeight) <= 1 
            && isBalanced(tree->left) 
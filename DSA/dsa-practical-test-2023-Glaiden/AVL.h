@@ -9,7 +9,9 @@
 #define AVL_H
 #include <iostream>
 #include <sstream>
+#include <future>
 #include <stack>
+#include <thread>
 #include "SimpleAllocator.h"
 #include <vector>
 
@@ -21,28 +23,29 @@
  *        However, it is up to you how you implement this class, as long as 
  *        the interface works as expected in test.cpp
  *        If you choose not to inherit from BST, you can remove all the 
- *        inheritance code, e.g., `: public BST<T>` from the class definition, 
+ *        inheritance code, e.g., `: public BST<T, Links>` from the class definition, 
  *        `virtual`/`override` modifiers from the inherited methods, etc.
  * @tparam T Type of data to be stored in the tree
  */
 #include "BST.h"
-template <typename T>
-class AVL : public BST<T> {
+template <typename T, typename Links = PointerLinks>
+class AVL : public BST<T, Links> {
 
 public:
 
     // This is a convenience type definition for the stack of path nodes.
     // It is used to trace back to the unbalanced node(s) after adding/removing, 
-    // as shown in class. Feel free to ignore this and use other techniques if you wish.
-    using PathStack = std::stack<typename BST<T>::BinTree>;
-    //using PathStack = std::vector<typename BST<T>::BinTree>;
+    // as shown in class. It holds the links (not the nodes) so that a rotation
+    // can replace the subtree a link points to.
+    using PathStack = typename BST<T, Links>::PathStack;
     /**
      * @brief Constructor.
      *        The inline implementation here calls the BST constructor.
      *        However, you can implement this from scratch if you wish.
      * @param allocator Pointer to the allocator to use for the tree.
+     * @param expectedSize Nodes per page of the tree's own pool (0 for the default).
      */
-    AVL(SimpleAllocator* allocator = nullptr) : BST<T>(allocator) {}
+    AVL(SimpleAllocator* allocator = nullptr, unsigned expectedSize = 0) : BST<T, Links>(allocator, expectedSize) {}
 
     /**
      * @brief Destructor
@@ -51,6 +54,16 @@ public:
      */
     virtual ~AVL() override {}
 
+    // copies are deep (O(1) and shared in copy-on-write mode); moves and swaps
+    // only hand over the root and allocator (O(1))
+    AVL(const AVL& rhs) = default;
+    AVL(AVL&& rhs) noexcept : BST<T, Links>(std::move(rhs)) {}
+    AVL& operator=(const AVL& rhs) = default;
+    AVL& operator=(AVL&& rhs) noexcept {
+        BST<T, Links>::operator=(std::move(rhs));
+        return *this;
+    }
+
     /**
      * @brief Add a new value to the tree and balance the tree.
      *        Use the techniques discussed in class to trace back to the
@@ -77,6 +90,56 @@ public:
      */
     virtual void remove(const T& value) override;
 
+    // buildFromSorted is inherited, the balanced tree it builds is an AVL tree
+
+    /**
+     * @brief Move the values less than key into left and the rest into right.
+     *        The pieces are joined back by height, so this is O(log n) and
+     *        both results are AVL trees. This tree ends up empty.
+     *        (Takes AVL trees so that a plain BST cannot end up joined in.)
+     * @param key to split at
+     * @param left tree to get the values < key
+     * @param right tree to get the values >= key
+     * @throw BSTException if left and right are the same tree
+     */
+    void split(const T& key, AVL& left, AVL& right);
+
+    /**
+     * @brief Replace the contents with the values of left followed by right,
+     *        in O(log n) with the height-based join. Both trees end up empty.
+     * @param left tree with the smaller values
+     * @param right tree with the larger values
+     * @throw BSTException if a value of left is greater than one of right
+     */
+    void join(AVL& left, AVL& right);
+
+    // above this many nodes in the two subtrees, a set operation hands one
+    // half of its recursion to another thread
+    static const unsigned PARALLEL_CUTOFF = 8192;
+
+    /**
+     * @brief Add the values of other that are not in this tree yet.
+     *        Join-based: other is split by our root and both halves are
+     *        merged recursively, O(m log(n/m + 1)) for sizes m <= n, with
+     *        the two halves in parallel above PARALLEL_CUTOFF.
+     *        Nodes move over (copied only if other uses another allocator)
+     *        and other ends up empty. Meant for trees without repeated values.
+     * @param other tree to merge in
+     */
+    void unionWith(AVL& other);
+
+    /**
+     * @brief Keep only the values that are also in other (see unionWith).
+     * @param other tree to intersect with, ends up empty
+     */
+    void intersectWith(AVL& other);
+
+    /**
+     * @brief Remove the values that are in other (see unionWith).
+     * @param other tree of values to remove, ends up empty
+     */
+    void differenceWith(AVL& other);
+
     /**
      * @brief Print the inorder traversal of the tree.
      * @return stringstream containing the inorder traversal of the tree
@@ -92,7 +155,7 @@ public:
      * @return height of the tree
      */
     int height() const {
-        return BST<T>::height();
+        return BST<T, Links>::height();
     }
 
     /**
@@ -104,7 +167,7 @@ public:
      * @return size of the tree
      */
     unsigned size() const {
-        return BST<T>::size();
+        return BST<T, Links>::size();
     }
     void inOrder(PathStack& pathNodes);
 
@@ -120,34 +183,35 @@ private:
      *        Note that you may need to update the counts and balance factors.
      * @param tree to be rotated
      */
-    void rotateLeft(typename BST<T>::BinTree& tree);
+    void rotateLeft(typename BST<T, Links>::BinTree& tree);
 
     /**
      * @brief Rotate the tree to the right.
      *        Note that you may need to update the counts and balance factors.
      * @param tree to be rotated
      */
-    void rotateRight(typename BST<T>::BinTree& tree);
+    void rotateRight(typename BST<T, Links>::BinTree& tree);
 
     /**
      * @brief Rotate the left subtree to the left, then the whole tree to the right.
      *        You may want to use the rotateLeft and rotateRight methods above.
      * @param tree to be rotated
      */
-    void rotateLeftRight(typename BST<T>::BinTree& tree);
+    void rotateLeftRight(typename BST<T, Links>::BinTree& tree);
 
     /**
      * @brief Rotate the right subtree to the right, then the whole tree to the left.
      *        You may want to use the rotateLeft and rotateRight methods above.
      * @param tree to be rotated
      */
-    void rotateRightLeft(typename BST<T>::BinTree& tree);
+    void rotateRightLeft(typename BST<T, Links>::BinTree& tree);
 
     /**
      * @brief Balance the tree from the stack of path nodes.
-     * @param pathNodes contain the stack of nodes from the root to the node just before
-     *                  the added/removed node after adding/remove operation
-     * @param stopAtFirst if true, stop after fixing the first unbalanced node
+     * @param pathNodes contain the stack of links from the root down to the
+     *                  added/removed node after adding/remove operation
+     * @param stopAtFirst if true, stop rotating after fixing the first unbalanced
+     *                    node (the nodes above still get their counts updated)
      */
     void balance(PathStack& pathNodes, bool stopAtFirst = false);
 
@@ -158,21 +222,47 @@ private:
      *        appropriate rotation methods above.
      * @param tree to be balanced
      */
-    void balancenode(typename BST<T>::BinTree& tree);
-
-    int height_(const typename BST<T>::BinTree& tree) const;
+    void balancenode(typename BST<T, Links>::BinTree& tree);
 
     // TODO: Again, you do not need to stick to the private methods above, 
     //       and likely you will need to add more of your own methods in order
     //       to make your code more readable and maintainable.
-    void printInorder_(const typename BST<T>::BinTree& tree, std::stringstream& ss) const;
-    void add_(typename BST<T>::BinTree& tree, const T& value, PathStack& pathNodes);
-    void remove_(typename BST<T>::BinTree& tree, const T& value, PathStack& pathNodes);
-    bool isBalanced(const typename BST<T>::BinTree& tree) const;
-    int getBalance(typename BST<T>::BinTree N);
-
-    // void rotateLeftWithStatsUpdate(typename BST<T>::BinTree& tree);
-    // void rotateRightWithStatsUpdate(typename BST<T>::BinTree& tree);
+    void printInorder_(const typename BST<T, Links>::BinTree& tree, std::stringstream& ss) const;
+    // equal values go right on add, so a sorted range may repeat values
+    virtual bool acceptsDuplicates() const override { return true; }
+    virtual typename BST<T, Links>::BinTree join3_(typename BST<T, Links>::BinTree left, typename BST<T, Links>::BinTree node,
+                                            typename BST<T, Links>::BinTree right) override;
+    virtual void fixPath_(PathStack& path) override;
+
+    enum SetOperation { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE };
+
+    /**
+     * @brief Run a set operation with other, which ends up empty
+     * @param op operation to run
+     * @param other tree to combine with
+     */
+    void setOperation(SetOperation op, AVL& other);
+
+    /**
+     * @brief Recursive step of a set operation on two subtrees
+     *        It only relinks nodes, the ones dropped are collected in
+     *        garbage and freed afterwards (the allocator is not thread safe)
+     * @param op operation to run
+     * @param a subtree of this tree
+     * @param b subtree of the other tree
+     * @param garbage subtrees to free once all the tasks are done
+     * @param depth levels left that may still start a parallel task
+     * @return root of the resulting subtree
+     */
+    typename BST<T, Links>::BinTree setOperation_(SetOperation op, typename BST<T, Links>::BinTree a, typename BST<T, Links>::BinTree b,
+                                           std::vector<typename BST<T, Links>::BinTree>& garbage, unsigned depth);
+    void add_(typename BST<T, Links>::BinTree& tree, const T& value, PathStack& pathNodes);
+    void remove_(typename BST<T, Links>::BinTree& tree, const T& value, PathStack& pathNodes);
+    bool isBalanced(const typename BST<T, Links>::BinTree& tree) const;
+    int getBalance(typename BST<T, Links>::BinTree N);
+
+    // void rotateLeftWithStatsUpdate(typename BST<T, Links>::BinTree& tree);
+    // void rotateRightWithStatsUpdate(typename BST<T, Links>::BinTree& tree);
 };
 
 #include "AVL.cpp"
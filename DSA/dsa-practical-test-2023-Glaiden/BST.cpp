@@ -2,40 +2,156 @@
 
 unsigned counter = 0;
 // Constructor
-template <typename T>
-BST<T>::BST(SimpleAllocator* allocator) : allocator_(allocator), isOwnAllocator_(allocator == nullptr), root_(nullptr) {
-    // Constructor implementation
+template <typename T, typename Links>
+BST<T, Links>::BST(SimpleAllocator* allocator, unsigned expectedSize)
+    : allocator_(allocator), root_(nullptr), copyOnWrite_(false) {
+    if (allocator_ == nullptr) {
+        ownAllocator_ = makeOwnAllocator_(expectedSize > 0 ? expectedSize : DEFAULT_NODES_PER_PAGE);
+        allocator_ = ownAllocator_.get();
+    }
+}
+
+// Create a pool of node-sized blocks, growing a page at a time without limit
+template <typename T, typename Links>
+std::shared_ptr<SimpleAllocator> BST<T, Links>::makeOwnAllocator_(unsigned nodesPerPage) {
+    if (Links::USES_HANDLES) {
+        // a handle only has room for so many slots per page
+        nodesPerPage = std::min(nodesPerPage, 1u << SimpleAllocator::HANDLE_SLOT_BITS);
+    }
+    SimpleAllocatorConfig config(false, nodesPerPage, UINT_MAX);
+    config.useHandles = Links::USES_HANDLES;
+    return std::make_shared<SimpleAllocator>(sizeof(BinTreeNode), config);
 }
 
 // Copy constructor
-template <typename T>
-BST<T>::BST(const BST& rhs) {
+template <typename T, typename Links>
+BST<T, Links>::BST(const BST& rhs) {
     allocator_ = rhs.allocator_;
-    isOwnAllocator_ = rhs.isOwnAllocator_;
+    ownAllocator_ = rhs.ownAllocator_;
+    copyOnWrite_ = rhs.copyOnWrite_;
     root_ = nullptr; // Initialize root for copying
+    if (!copyOnWrite_ && ownAllocator_ != nullptr) {
+        // a deep copy is independent of rhs, down to the (unsynchronized) pool
+        ownAllocator_ = makeOwnAllocator_(rhs.ownAllocator_->getConfig().objectsPerPage);
+        allocator_ = ownAllocator_.get();
+    }
+    if (copyOnWrite_) {
+        // share rhs's nodes, they are copied only once either tree changes them
+        root_ = rhs.root_;
+        if (root_ != nullptr) {
+            ++root_->refs;
+        }
+        return;
+    }
     copy_(root_, rhs.root_);
 }
 
+// Move constructor
+template <typename T, typename Links>
+BST<T, Links>::BST(BST&& rhs) noexcept
+    : allocator_(rhs.allocator_), ownAllocator_(rhs.ownAllocator_), root_(rhs.root_), copyOnWrite_(rhs.copyOnWrite_) {
+    rhs.root_ = nullptr;
+}
+
 // Assignment operator
-template <typename T>
-BST<T>& BST<T>::operator=(const BST& rhs) {
+template <typename T, typename Links>
+BST<T, Links>& BST<T, Links>::operator=(const BST& rhs) {
+    if (this != &rhs) {
+        if (rhs.copyOnWrite_) {
+            // take a reference first, we may already share rhs's root
+            BinTree tree = rhs.root_;
+            if (tree != nullptr) {
+                ++tree->refs;
+            }
+            clear();
+            allocator_ = rhs.allocator_;
+            ownAllocator_ = rhs.ownAllocator_;
+            copyOnWrite_ = true;
+            root_ = tree;
+            return *this;
+        }
+        copyOnWrite_ = false;
+        if (rhs.ownAllocator_ != nullptr && (ownAllocator_ == nullptr || ownAllocator_ == rhs.ownAllocator_)) {
+            // a deep copy is independent of rhs, so it does not go on
+            // allocating from rhs's pool (or an outside allocator)
+            clear();
+            ownAllocator_ = makeOwnAllocator_(rhs.ownAllocator_->getConfig().objectsPerPage);
+            allocator_ = ownAllocator_.get();
+            copy_(root_, rhs.root_);
+            return *this;
+        }
+        if (rhs.ownAllocator_ == nullptr && allocator_ != rhs.allocator_) {
+            clear(); // the nodes go back to the old allocator before it is let go
+            allocator_ = rhs.allocator_;
+            ownAllocator_ = rhs.ownAllocator_;
+            copy_(root_, rhs.root_);
+            return *this;
+        }
+
+        // same allocator: our blocks are reused, only the shortfall is allocated
+        std::vector<BinTree> spare;
+        spare.reserve(size());
+        clear_(root_, &spare);
+        try {
+            copy_(root_, rhs.root_, &spare);
+        } catch (...) {
+            clear_(root_);
+            for (BinTree block : spare) {
+                Links::free(*allocator_, block);
+            }
+            throw;
+        }
+        for (BinTree block : spare) {
+            Links::free(*allocator_, block);
+        }
+    }
+    return *this;
+}
+
+// Move assignment operator
+template <typename T, typename Links>
+BST<T, Links>& BST<T, Links>::operator=(BST&& rhs) noexcept {
     if (this != &rhs) {
         clear();
         allocator_ = rhs.allocator_;
-        copy_(root_, rhs.root_);
+        ownAllocator_ = rhs.ownAllocator_;
+        copyOnWrite_ = rhs.copyOnWrite_;
+        root_ = rhs.root_;
+        rhs.root_ = nullptr;
     }
     return *this;
 }
 
+// Swap the contents and allocators of two trees
+template <typename T, typename Links>
+void BST<T, Links>::swap(BST& rhs) noexcept {
+    std::swap(allocator_, rhs.allocator_);
+    ownAllocator_.swap(rhs.ownAllocator_);
+    std::swap(root_, rhs.root_);
+    std::swap(copyOnWrite_, rhs.copyOnWrite_);
+}
+
+// Make copies of this tree share its nodes
+template <typename T, typename Links>
+void BST<T, Links>::enableCopyOnWrite() {
+    copyOnWrite_ = true;
+}
+
+// Check if copies of the tree share its nodes
+template <typename T, typename Links>
+bool BST<T, Links>::copyOnWrite() const {
+    return copyOnWrite_;
+}
+
 // Destructor
-template <typename T>
-BST<T>::~BST() {
+template <typename T, typename Links>
+BST<T, Links>::~BST() {
     clear();
 }
 
 // Subscript operator
-template <typename T>
-const typename BST<T>::BinTreeNode* BST<T>::operator[](int index) const
+template <typename T, typename Links>
+const typename BST<T, Links>::BinTreeNode* BST<T, Links>::operator[](int index) const
 {
         if(this->size() <= (unsigned)index || index < 0){
         throw BSTException(1, "Index out of bounds");
@@ -46,95 +162,520 @@ const typename BST<T>::BinTreeNode* BST<T>::operator[](int index) const
 }
 
 // Add a value to the tree
-template <typename T>
-void BST<T>::add(const T& value) noexcept(false) {
+template <typename T, typename Links>
+void BST<T, Links>::add(const T& value) noexcept(false) {
     add_(root_, value);
 }
 
 // Remove a value from the tree
-template <typename T>
-void BST<T>::remove(const T& value) {
+template <typename T, typename Links>
+void BST<T, Links>::remove(const T& value) {
     remove_(root_, value);
 }
 
 // Clear the tree
-template <typename T>
-void BST<T>::clear() {
+template <typename T, typename Links>
+void BST<T, Links>::clear() {
     clear_(root_);
 }
 
-template <typename T>
-void BST<T>::clear_(BinTree& tree) {
-    if (tree == nullptr) {
-        return;
+// Replace the contents with a range of sorted values
+template <typename T, typename Links>
+template <typename ForwardIt>
+void BST<T, Links>::buildFromSorted(ForwardIt first, ForwardIt last) {
+    // first pass: check the order and count the values
+    size_t n = 0;
+    for (ForwardIt it = first, prev = first; it != last; prev = it, ++it, ++n) {
+        if (n == 0) {
+            continue;
+        }
+        if (*it < *prev) {
+            throw BSTException(BSTException::E_NOT_SORTED, "Values to build from are not sorted");
+        }
+        if (!(*prev < *it) && !acceptsDuplicates()) {
+            throw BSTException(BSTException::E_DUPLICATE, "Values to build from have duplicates");
+        }
+    }
+
+    // allocate every node up front, so a failure leaves the tree as it was
+    std::vector<BinTree> blocks;
+    blocks.reserve(n);
+    try {
+        for (size_t i = 0; i < n; ++i) {
+            blocks.push_back(Links::template allocate<BinTreeNode>(*allocator_));
+        }
+    } catch (const SimpleAllocatorException& e) {
+        for (BinTree block : blocks) {
+            Links::free(*allocator_, block);
+        }
+        throw BSTException(BSTException::E_NO_MEMORY, e.what());
+    }
+
+    // second pass: construct the nodes in order
+    BinTree tree = nullptr;
+    size_t next = 0;
+    try {
+        tree = buildBalanced_(first, n, blocks, next);
+    } catch (...) {
+        // T's copy constructor threw, the nodes made so far are blocks [0, next)
+        for (size_t i = 0; i < next; ++i) {
+            blocks[i]->~BinTreeNode();
+        }
+        for (BinTree block : blocks) {
+            Links::free(*allocator_, block);
+        }
+        throw;
+    }
+    clear();
+    root_ = tree;
+}
+
+// Build a balanced tree of the next n values, in order
+template <typename T, typename Links>
+template <typename ForwardIt>
+typename BST<T, Links>::BinTree BST<T, Links>::buildBalanced_(ForwardIt& it, size_t n, const std::vector<BinTree>& blocks, size_t& next) {
+    if (n == 0) {
+        return nullptr;
+    }
+    size_t leftSize = n / 2; // the left half gets the extra node, heights differ by at most 1
+    BinTree left = buildBalanced_(it, leftSize, blocks, next);
+    BinTree tree = blocks[next];
+    new (static_cast<BinTreeNode*>(tree)) BinTreeNode(*it);
+    ++next;
+    ++it;
+    tree->left = left;
+    tree->right = buildBalanced_(it, n - 1 - leftSize, blocks, next);
+    updateStats(tree);
+    return tree;
+}
+
+template <typename T, typename Links>
+void BST<T, Links>::clear_(BinTree& tree, std::vector<BinTree>* spare) {
+    while (tree != nullptr) {
+        if (tree->refs > 1) {
+            // still in another tree, which keeps the whole subtree
+            --tree->refs;
+            tree = nullptr;
+        } else if (tree->left != nullptr && tree->left->refs > 1) {
+            // a shared left subtree cannot be rotated, just let go of it
+            --tree->left->refs;
+            tree->left = nullptr;
+        } else if (tree->left != nullptr) {
+            // rotate the left child up, the tree stays the same size
+            BinTree left = tree->left;
+            tree->left = left->right;
+            left->right = tree;
+            tree = left;
+        } else {
+            // no left child, free the node and carry on to the right
+            BinTree right = tree->right;
+            if (spare != nullptr) {
+                tree->~BinTreeNode();
+                spare->push_back(tree);
+            } else {
+                freeNode(tree);
+            }
+            tree = right;
+        }
     }
-    clear_(tree->left);
-    clear_(tree->right);
-    freeNode(tree);
-    tree = nullptr;
 }
 // Find a value in the tree
-template <typename T>
-bool BST<T>::find(const T& value, unsigned& compares) const {
+template <typename T, typename Links>
+bool BST<T, Links>::find(const T& value, unsigned& compares) const {
     return find_(root_, value, compares);
 }
 
-// Check if the tree is empty
-template <typename T>
-bool BST<T>::empty() const {
-    // Implement the empty function
-    if (height() < 0){
-        return true;
+// Export the values into an immutable array-based tree
+template <typename T, typename Links>
+FrozenBST<T> BST<T, Links>::freeze(typename FrozenBST<T>::Layout layout) const {
+    return FrozenBST<T>(begin(), end(), layout);
+}
+
+// Move the values less than key into left and the rest into right
+template <typename T, typename Links>
+void BST<T, Links>::split(const T& key, BST& left, BST& right) {
+    if (&left == &right) {
+        throw BSTException(BSTException::E_NOT_SORTED, "Cannot split a tree into the same tree twice");
+    }
+    // detach our nodes first, left or right may be this tree
+    BinTree tree = root_;
+    root_ = nullptr;
+    SimpleAllocator* allocator = allocator_;
+    std::shared_ptr<SimpleAllocator> ownAllocator = ownAllocator_; // keeps our pool alive meanwhile
+    if (&left != this) {
+        left.clear();
+    }
+    if (&right != this) {
+        right.clear();
+    }
+    left.allocator_ = right.allocator_ = allocator;
+    left.ownAllocator_ = right.ownAllocator_ = ownAllocator;
+    left.copyOnWrite_ = right.copyOnWrite_ = copyOnWrite_; // the nodes may be shared
+    split_(tree, key, false, left.root_, right.root_);
+}
+
+// Replace the contents with the values of left followed by right
+template <typename T, typename Links>
+void BST<T, Links>::join(BST& left, BST& right) {
+    if (&left == &right) {
+        throw BSTException(BSTException::E_NOT_SORTED, "Cannot join a tree with itself");
+    }
+    if (!left.empty() && !right.empty()) {
+        const T& largest = *--left.end();
+        const T& smallest = *right.begin();
+        if (smallest < largest || (!acceptsDuplicates() && !(largest < smallest))) {
+            throw BSTException(BSTException::E_NOT_SORTED, "Values of the left tree are not all below the right tree");
+        }
+    }
+
+    // detach both trees, keeping left's pool alive while we switch over
+    BinTree larger = left.takeNodes_(right);
+    BinTree smaller = left.root_;
+    SimpleAllocator* allocator = left.allocator_;
+    std::shared_ptr<SimpleAllocator> ownAllocator = left.ownAllocator_;
+    bool copyOnWrite = left.copyOnWrite_ || right.copyOnWrite_;
+    left.root_ = nullptr;
+    clear();
+    allocator_ = allocator;
+    ownAllocator_ = ownAllocator;
+    copyOnWrite_ = copyOnWrite;
+    root_ = join2_(smaller, larger);
+}
+
+// Take the nodes of another tree, which ends up empty
+template <typename T, typename Links>
+typename BST<T, Links>::BinTree BST<T, Links>::takeNodes_(BST& other) {
+    BinTree tree = other.root_;
+    if (other.allocator_ != allocator_) {
+        // the nodes must be freed to our allocator later, so copy them over
+        tree = nullptr;
+        try {
+            copy_(tree, other.root_);
+        } catch (...) {
+            clear_(tree);
+            throw;
+        }
+        other.clear();
+    } else if (other.copyOnWrite_) {
+        copyOnWrite_ = true; // the nodes may be shared
+    }
+    other.root_ = nullptr;
+    return tree;
+}
+
+// Split a subtree at a key into the values below it and the rest
+template <typename T, typename Links>
+void BST<T, Links>::split_(BinTree tree, const T& key, bool inclusive, BinTree& left, BinTree& right) {
+    // walk down to where key would go, remembering the nodes passed
+    // (they all get relinked, so they must be ours alone)
+    std::vector<BinTree> path;
+    BinTree* link = &tree;
+    while (*link != nullptr) {
+        unshare_(*link);
+        path.push_back(*link);
+        link = goesLeft_((*link)->data, key, inclusive) ? &(*link)->right : &(*link)->left;
+    }
+
+    // bottom-up, each node takes its far subtree to the side it belongs to
+    BinTree smaller = nullptr;
+    BinTree larger = nullptr;
+    while (!path.empty()) {
+        BinTree node = path.back();
+        path.pop_back();
+        if (goesLeft_(node->data, key, inclusive)) {
+            smaller = join3_(node->left, node, smaller);
+        } else {
+            larger = join3_(larger, node, node->right);
+        }
+    }
+    left = smaller;
+    right = larger;
+}
+
+// Join two subtrees, every value of left being below those of right
+template <typename T, typename Links>
+typename BST<T, Links>::BinTree BST<T, Links>::join2_(BinTree left, BinTree right) {
+    if (right == nullptr) {
+        return left;
+    }
+
+    // unlink the smallest node of right and join around it
+    PathStack path;
+    BinTree* link = &right;
+    unshare_(*link);
+    while ((*link)->left != nullptr) {
+        path.push_back(link);
+        link = &(*link)->left;
+        unshare_(*link);
+    }
+    BinTree middle = *link;
+    *link = middle->right;
+    path.push_back(link);
+    fixPath_(path);
+    return join3_(left, middle, right);
+}
+
+// Join two subtrees with a node whose value lies between them
+template <typename T, typename Links>
+typename BST<T, Links>::BinTree BST<T, Links>::join3_(BinTree left, BinTree node, BinTree right) {
+    node->left = left;
+    node->right = right;
+    updateStats(node);
+    return node;
+}
+
+// Update the nodes of a path bottom-up after a node below changed
+template <typename T, typename Links>
+void BST<T, Links>::fixPath_(PathStack& path) {
+    while (!path.empty()) {
+        if (*path.back() != nullptr) {
+            updateStats(*path.back());
+        }
+        path.pop_back();
     }
-    return false;
+}
+
+// Count the values less than the given one
+template <typename T, typename Links>
+unsigned BST<T, Links>::rank(const T& value) const {
+    return rank_(value, false);
+}
+
+// Get the k-th smallest value
+template <typename T, typename Links>
+const T& BST<T, Links>::select(unsigned k) const {
+    if (k >= size()) {
+        throw BSTException(BSTException::E_OUT_BOUNDS, "Index out of bounds");
+    }
+    return getNode_(root_, k)->data;
+}
+
+// Count the values in [lo, hi]
+template <typename T, typename Links>
+unsigned BST<T, Links>::countRange(const T& lo, const T& hi) const {
+    if (hi < lo) {
+        return 0;
+    }
+    return rank_(hi, true) - rank_(lo, false);
+}
+
+// Count the values less than (or not greater than) a value
+// - every time we go right, the left subtree and the node itself are below it
+template <typename T, typename Links>
+unsigned BST<T, Links>::rank_(const T& value, bool inclusive) const {
+    unsigned below = 0;
+    BinTree node = root_;
+    while (node != nullptr) {
+        if (node->data < value || (inclusive && !(value < node->data))) {
+            below += size_(node->left) + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return below;
+}
+
+// Check if the tree is empty
+template <typename T, typename Links>
+bool BST<T, Links>::empty() const {
+    return root_ == nullptr;
 }
 // Get the number of nodes in the tree
-template <typename T>
-unsigned int BST<T>::size() const {
+template <typename T, typename Links>
+unsigned int BST<T, Links>::size() const {
     return size_(root_);
 }
 
 // Get the height of the tree
-template <typename T>
-int BST<T>::height() const {
+template <typename T, typename Links>
+int BST<T, Links>::height() const {
     return height_(root_);
 }
 
 // Get the root of the tree
-template <typename T>
-typename BST<T>::BinTree BST<T>::root() const {
+template <typename T, typename Links>
+typename BST<T, Links>::BinTree BST<T, Links>::root() const {
     return root_;
 }
 
+// Step to the next value in order
+template <typename T, typename Links>
+typename BST<T, Links>::const_iterator& BST<T, Links>::const_iterator::operator++() {
+    BinTree node = path_.back();
+    if (node->right != nullptr) {
+        // the next value is the leftmost one of the right subtree
+        path_.push_back(node->right);
+        descend(true);
+        return *this;
+    }
+    // otherwise climb until we come up from a left child
+    path_.pop_back();
+    while (!path_.empty() && path_.back()->right == node) {
+        node = path_.back();
+        path_.pop_back();
+    }
+    return *this;
+}
+
+// Step to the previous value in order
+template <typename T, typename Links>
+typename BST<T, Links>::const_iterator& BST<T, Links>::const_iterator::operator--() {
+    if (path_.empty()) {
+        // from end() to the largest value
+        if (root_ != nullptr) {
+            path_.push_back(root_);
+            descend(false);
+        }
+        return *this;
+    }
+    BinTree node = path_.back();
+    if (node->left != nullptr) {
+        // the previous value is the rightmost one of the left subtree
+        path_.push_back(node->left);
+        descend(false);
+        return *this;
+    }
+    // otherwise climb until we come up from a right child
+    path_.pop_back();
+    while (!path_.empty() && path_.back()->left == node) {
+        node = path_.back();
+        path_.pop_back();
+    }
+    return *this;
+}
+
+// Go down the leftmost (or rightmost) path from the back of path_
+template <typename T, typename Links>
+void BST<T, Links>::const_iterator::descend(bool leftmost) {
+    BinTree next = leftmost ? path_.back()->left : path_.back()->right;
+    while (next != nullptr) {
+        path_.push_back(next);
+        next = leftmost ? next->left : next->right;
+    }
+}
+
+// Get an iterator to the smallest value
+template <typename T, typename Links>
+typename BST<T, Links>::const_iterator BST<T, Links>::begin() const {
+    const_iterator it = end();
+    if (root_ != nullptr) {
+        it.path_.reserve(height() + 1);
+        it.path_.push_back(root_);
+        it.descend(true);
+    }
+    return it;
+}
+
+// Get the iterator past the largest value
+template <typename T, typename Links>
+typename BST<T, Links>::const_iterator BST<T, Links>::end() const {
+    const_iterator it;
+    it.root_ = root_;
+    return it;
+}
+
+// Find the first value not less than the given one
+template <typename T, typename Links>
+typename BST<T, Links>::const_iterator BST<T, Links>::lower_bound(const T& value) const {
+    const_iterator it = end();
+    size_t found = 0; // path length up to the best candidate so far (0 = none)
+    for (BinTree node = root_; node != nullptr;) {
+        it.path_.push_back(node);
+        if (node->data < value) {
+            node = node->right;
+        } else {
+            found = it.path_.size();
+            node = node->left;
+        }
+    }
+    it.path_.resize(found);
+    return it;
+}
+
+// Find the first value greater than the given one
+template <typename T, typename Links>
+typename BST<T, Links>::const_iterator BST<T, Links>::upper_bound(const T& value) const {
+    const_iterator it = end();
+    size_t found = 0; // path length up to the best candidate so far (0 = none)
+    for (BinTree node = root_; node != nullptr;) {
+        it.path_.push_back(node);
+        if (value < node->data) {
+            found = it.path_.size();
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    it.path_.resize(found);
+    return it;
+}
+
+// Get the range of values equal to the given one
+template <typename T, typename Links>
+std::pair<typename BST<T, Links>::const_iterator, typename BST<T, Links>::const_iterator> BST<T, Links>::equal_range(const T& value) const {
+    return std::make_pair(lower_bound(value), upper_bound(value));
+}
+
 // Allocate a new node
-template <typename T>
-typename BST<T>::BinTree BST<T>::makeNode(const T& value) {
-    BinTree tree = new BinTreeNode(value);
-    return tree;
+template <typename T, typename Links>
+typename BST<T, Links>::BinTree BST<T, Links>::makeNode(const T& value) {
+    BinTree node = nullptr;
+    try {
+        node = Links::template allocate<BinTreeNode>(*allocator_);
+    } catch (const SimpleAllocatorException& e) {
+        throw BSTException(BSTException::E_NO_MEMORY, e.what());
+    }
+    try {
+        new (static_cast<BinTreeNode*>(node)) BinTreeNode(value);
+        return node;
+    } catch (...) {
+        // T's copy constructor threw, give the block back
+        Links::free(*allocator_, node);
+        throw;
+    }
 }
 
 // Free a node
-template <typename T>
-void BST<T>::freeNode(typename BST<T>::BinTree node) {
-    delete node;
-    
+template <typename T, typename Links>
+void BST<T, Links>::freeNode(typename BST<T, Links>::BinTree node) {
+    node->~BinTreeNode();
+    Links::free(*allocator_, node);
 }
 
 // Calculate the height of the tree
-template <typename T>
-int BST<T>::treeHeight(typename BST<T>::BinTree tree) const {
+template <typename T, typename Links>
+int BST<T, Links>::treeHeight(typename BST<T, Links>::BinTree tree) const {
     if (tree == nullptr) {
         return -1; // Height of an empty tree
     }
-    int leftHeight = treeHeight(tree->left);
-    int rightHeight = treeHeight(tree->right);
-    tree->height_ = std::max(leftHeight, rightHeight) + 1;
-    return std::max(leftHeight, rightHeight) + 1;
+    // post-order walk: a node is pushed twice, its height is set on the second visit
+    std::vector<std::pair<BinTree, bool>> stack;
+    stack.push_back(std::make_pair(tree, false));
+    while (!stack.empty()) {
+        BinTree node = stack.back().first;
+        bool childrenDone = stack.back().second;
+        stack.pop_back();
+        if (childrenDone) {
+            int leftHeight = node->left ? node->left->height_ : -1;
+            int rightHeight = node->right ? node->right->height_ : -1;
+            node->height_ = std::max(leftHeight, rightHeight) + 1;
+            continue;
+        }
+        stack.push_back(std::make_pair(node, true));
+        if (node->right != nullptr) {
+            stack.push_back(std::make_pair(node->right, false));
+        }
+        if (node->left != nullptr) {
+            stack.push_back(std::make_pair(node->left, false));
+        }
+    }
+    return tree->height_;
 }
 
 // Find the predecessor of a node
-template <typename T>
-void BST<T>::findPredecessor(typename BST<T>::BinTree tree, typename BST<T>::BinTree& predecessor) const {
+template <typename T, typename Links>
+void BST<T, Links>::findPredecessor(typename BST<T, Links>::BinTree tree, typename BST<T, Links>::BinTree& predecessor) const {
     if (tree->left == nullptr) {
         return;
     }
@@ -146,8 +687,8 @@ void BST<T>::findPredecessor(typename BST<T>::BinTree tree, typename BST<T>::Bin
 }
 
 // Check if the tree is empty
-template <typename T>
-bool BST<T>::isEmpty(const typename BST<T>::BinTree& tree) const {
+template <typename T, typename Links>
+bool BST<T, Links>::isEmpty(const typename BST<T, Links>::BinTree& tree) const {
     if(tree ==nullptr)
     {
         return true;
@@ -160,132 +701,235 @@ bool BST<T>::isEmpty(const typename BST<T>::BinTree& tree) const {
 
 
 // Check if the tree is a leaf
-template <typename T>
-bool BST<T>::isLeaf(const typename BST<T>::BinTree& tree) const {
+template <typename T, typename Links>
+bool BST<T, Links>::isLeaf(const typename BST<T, Links>::BinTree& tree) const {
     return tree != nullptr && tree->left == nullptr && tree->right == nullptr;
 }
 
-// A recursive step to add a value into the tree
-template <typename T>
-void BST<T>::add_(typename BST<T>::BinTree& tree, const T& value) {
-    if (tree == nullptr) {
-        tree = makeNode(value);
-        return;
+// Add a value into the tree, walking down iteratively
+template <typename T, typename Links>
+void BST<T, Links>::add_(typename BST<T, Links>::BinTree& tree, const T& value) {
+    path_.clear();
+    BinTree* link = &tree;
+    while (*link != nullptr) {
+        if (value < (*link)->data) {
+            path_.push_back(link);
+            link = &(*link)->left;
+        } else if (value > (*link)->data) {
+            path_.push_back(link);
+            link = &(*link)->right;
+        } else {
+            // Value already exists, throw an exception
+            throw BSTException(BSTException::E_DUPLICATE, "Value already exists in the tree");
+        }
     }
-    if (value < tree->data) {
-        add_(tree->left, value);
-    } else if (value > tree->data) {
-        add_(tree->right, value);
-    } else {
-        // Value already exists, throw an exception
-        throw BSTException(BSTException::E_DUPLICATE, "Value already exists in the tree");
+
+    // the value is new, so the nodes passed change (their stats)
+    path_.push_back(link);
+    unsharePath_(path_);
+    link = path_.back();
+    path_.pop_back();
+    *link = makeNode(value);
+
+    // one more node below every node on the path
+    while (!path_.empty()) {
+        updateStats(*path_.back());
+        path_.pop_back();
     }
 }
 
-// A recursive step to find the value in the tree
-template <typename T>
-bool BST<T>::find_(const typename BST<T>::BinTree& tree, const T& value, unsigned& compares) const {
-    if (isEmpty(tree)==true) { //check if tree node is 
-        return false;
-    }
-    if (value < tree->data) {
+// Find the value in the tree, walking down iteratively
+template <typename T, typename Links>
+bool BST<T, Links>::find_(const typename BST<T, Links>::BinTree& tree, const T& value, unsigned& compares) const {
+    BinTree node = tree;
+    while (isEmpty(node) == false) {
         compares++; // Increment comparison count
-        return find_(tree->left, value, compares);
-    } else if (value > tree->data) {
-        compares++; // Increment comparison count
-        return find_(tree->right, value, compares);
+        if (value < node->data) {
+            node = node->left;
+        } else if (value > node->data) {
+            node = node->right;
+        } else {
+            return true; // Value found
+        }
+    }
+    return false;
+}
 
-    } else if(value == tree->data) {
-        compares++; // Increment comparison count
-        return true; // Value found
-    } else {
-        return false;
+// Get to the node at the specified index, walking down iteratively
+template <typename T, typename Links>
+const typename BST<T, Links>::BinTree BST<T, Links>::getNode_(const typename BST<T, Links>::BinTree& tree, int index) const {
+    BinTree node = tree;
+    while (node != nullptr && index >= 0) {
+        int leftSubtreeSize = size_(node->left);
+        if (index < leftSubtreeSize) {
+            // The node is in the left subtree
+            node = node->left;
+        } else if (index == leftSubtreeSize) {
+            // The current node is the one at the specified index
+            return node;
+        } else {
+            // The node is in the right subtree
+            index -= leftSubtreeSize + 1;
+            node = node->right;
+        }
     }
+    // Index out of range or empty tree
+    throw BSTException(BSTException::E_OUT_BOUNDS, "Index is out of range or tree is empty");
+}
+
+// Get the size of a subtree from its cached count
+template <typename T, typename Links>
+unsigned BST<T, Links>::size_(const typename BST<T, Links>::BinTree& tree) const {
+    return tree == nullptr ? 0 : tree->count;
+}
+
+// Recompute a node's cached count and height from its children
+template <typename T, typename Links>
+void BST<T, Links>::updateStats(typename BST<T, Links>::BinTree tree) {
+    tree->count = 1 + size_(tree->left) + size_(tree->right);
+    tree->height_ = 1 + std::max(height_(tree->left), height_(tree->right));
 }
 
-// A recursive step to get to the node at the specified index
-template <typename T>
-const typename BST<T>::BinTree BST<T>::getNode_(const typename BST<T>::BinTree& tree, int index) const {
-    if (tree == nullptr || index < 0) {
-        // Index out of range or empty tree
-        throw BSTException(BSTException::E_OUT_BOUNDS, "Index is out of range or tree is empty");
+
+// Remove a value from the tree, walking down iteratively
+template <typename T, typename Links>
+void BST<T, Links>::remove_(typename BST<T, Links>::BinTree& tree, const T& value) {
+    findPath_(tree, value, path_);
+    if (*path_.back() == nullptr) {
+        // Value not found, throw an exception
+        throw BSTException(BSTException::E_NOT_FOUND, "Value to remove not found in the tree");
     }
-    int leftSubtreeSize = size_(tree->left);
-    if (index < leftSubtreeSize) {
-        // The node is in the left subtree
-        return getNode_(tree->left, index);
-    } else if (index == leftSubtreeSize) {
-        // The current node is the one at the specified index
-        return tree;
-    } else {
-        // The node is in the right subtree
-        return getNode_(tree->right, index - leftSubtreeSize - 1);
+    unlinkPath_(path_);
+
+    // one node less below every node still on the path (the last link may now be empty)
+    while (!path_.empty()) {
+        if (*path_.back() != nullptr) {
+            updateStats(*path_.back());
+        }
+        path_.pop_back();
     }
 }
 
-// A recursive step to calculate the size of the tree
-template <typename T>
-unsigned BST<T>::size_(const typename BST<T>::BinTree& tree) const {
-    if (tree == nullptr) {
-        return 0;
+// Walk down to the node holding a value, pushing every link passed
+template <typename T, typename Links>
+void BST<T, Links>::findPath_(typename BST<T, Links>::BinTree& tree, const T& value, PathStack& path) {
+    path.clear();
+    BinTree* link = &tree;
+    path.push_back(link);
+    while (*link != nullptr) {
+        if (value == (*link)->data) {
+            break;
+        }
+        link = value < (*link)->data ? &(*link)->left : &(*link)->right;
+        path.push_back(link);
     }
 
-    // Recursively count the nodes in the left and right subtrees
-    int leftSize = size_(tree->left);
-    int rightSize = size_(tree->right);
-    // Return the total size, which is the sum of the left and right subtree sizes plus 1 for the current node
-    return leftSize + rightSize + 1;
+    // only a value that is there gets its path changed
+    if (*path.back() != nullptr) {
+        unsharePath_(path);
+    }
 }
 
+// Make the nodes of a path ours alone, from the top down
+template <typename T, typename Links>
+void BST<T, Links>::unsharePath_(PathStack& path) {
+    if (!copyOnWrite_) {
+        return;
+    }
+    for (size_t i = 0; i < path.size() && *path[i] != nullptr; ++i) {
+        // the link below a copied node must point into the copy
+        BinTree node = *path[i];
+        unshare_(*path[i]);
+        if (i + 1 < path.size()) {
+            path[i + 1] = path[i + 1] == &node->left ? &(*path[i])->left : &(*path[i])->right;
+        }
+    }
+}
 
-// A recursive step to remove a value from the tree
-template <typename T>
-void BST<T>::remove_(typename BST<T>::BinTree& tree, const T& value) {
-    if (tree == nullptr) {
-        // Value not found, throw an exception
-        throw BSTException(BSTException::E_NOT_FOUND, "Value to remove not found in the tree");
+// Make the node a link points to ours alone before changing it
+template <typename T, typename Links>
+void BST<T, Links>::unshare_(typename BST<T, Links>::BinTree& tree) {
+    if (tree == nullptr || tree->refs == 1) {
+        return;
+    }
+    // the copy takes our reference, and holds one of each child
+    BinTree node = makeNode(tree->data);
+    node->left = tree->left;
+    node->right = tree->right;
+    node->count = tree->count;
+    node->height_ = tree->height_;
+    if (node->left != nullptr) {
+        ++node->left->refs;
+    }
+    if (node->right != nullptr) {
+        ++node->right->refs;
     }
-    if (value < tree->data) {
-        remove_(tree->left, value);
-    } else if (value > tree->data) {
-        remove_(tree->right, value);
+    --tree->refs;
+    tree = node;
+}
+
+// Unlink and free the node the last link of the path points to
+template <typename T, typename Links>
+void BST<T, Links>::unlinkPath_(PathStack& path) {
+    BinTree& tree = *path.back();
+    if (tree->left == nullptr) {
+        // Case 1: No left child or both children are nullptr
+        BinTree temp = tree->right;
+        freeNode(tree);
+        tree = temp;
+    } else if (tree->right == nullptr) {
+        // Case 2: No right child
+        BinTree temp = tree->left;
+        freeNode(tree);
+        tree = temp;
     } else {
-        // Value found, determine the case
-        if (tree->left == nullptr) {
-            // Case 1: No left child or both children are nullptr
-            BinTree temp = tree->right;
-            freeNode(tree);
-            tree = temp;
-        } else if (tree->right == nullptr) {
-            // Case 2: No right child
-            BinTree temp = tree->left;
-            freeNode(tree);
-            tree = temp;
-        } else {
-            // Case 3: Node has two children
-            BinTree predecessor = nullptr;
-            findPredecessor(tree, predecessor);
-            tree->data = predecessor->data;
-            remove_(tree->left, predecessor->data);
+        // Case 3: Node has two children, the predecessor (which has no
+        //         right child) gives up its value and is unlinked instead
+        BinTree* link = &tree->left;
+        unshare_(*link);
+        path.push_back(link);
+        while ((*link)->right != nullptr) {
+            link = &(*link)->right;
+            unshare_(*link);
+            path.push_back(link);
         }
+        BinTree predecessor = *link;
+        tree->data = predecessor->data;
+        *link = predecessor->left;
+        freeNode(predecessor);
     }
 }
 
-// A recursive step to calculate the height of the tree
-template <typename T>
-int BST<T>::height_(const typename BST<T>::BinTree& tree) const {
-    return treeHeight(tree);
+// Get the height of a subtree from its cached height
+template <typename T, typename Links>
+int BST<T, Links>::height_(const typename BST<T, Links>::BinTree& tree) const {
+    return tree == nullptr ? -1 : tree->height_;
 }
 
-// A recursive step to copy the tree
-template <typename T>
-void BST<T>::copy_(typename BST<T>::BinTree& tree, const typename BST<T>::BinTree& rtree) {
-    if (rtree == nullptr) {
-        tree = nullptr;
-    } else {
-        tree = makeNode(rtree->data);
-        copy_(tree->left, rtree->left);
-        copy_(tree->right, rtree->right);
+// Copy the tree with an explicit stack of (link to fill, node to copy)
+template <typename T, typename Links>
+void BST<T, Links>::copy_(typename BST<T, Links>::BinTree& tree, const typename BST<T, Links>::BinTree& rtree, std::vector<BinTree>* spare) {
+    std::vector<std::pair<BinTree*, BinTree>> stack;
+    stack.push_back(std::make_pair(&tree, rtree));
+    while (!stack.empty()) {
+        BinTree* link = stack.back().first;
+        BinTree source = stack.back().second;
+        stack.pop_back();
+        if (source == nullptr) {
+            *link = nullptr;
+            continue;
+        }
+        if (spare != nullptr && !spare->empty()) {
+            new (static_cast<BinTreeNode*>(spare->back())) BinTreeNode(source->data);
+            *link = spare->back();
+            spare->pop_back(); // only once constructed, so a throw leaves the block spare
+        } else {
+            *link = makeNode(source->data);
+        }
+        (*link)->count = source->count;
+        (*link)->height_ = source->height_;
+        stack.push_back(std::make_pair(&(*link)->right, source->right));
+        stack.push_back(std::make_pair(&(*link)->left, source->left));
     }
 }
 
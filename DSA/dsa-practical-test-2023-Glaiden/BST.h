@@ -10,8 +10,17 @@
 #ifndef BST_H
 #define BST_H
 #include "SimpleAllocator.h" // to use your SimpleAllocator
+#include "BSTLinks.h" // the node layouts (pointer or handle children)
+#include "FrozenBST.h" // the read-only copy made by freeze()
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 /**
  * @class BSTException
@@ -25,7 +34,7 @@ class BSTException : public std::exception {
     BSTException(int ErrCode, const std::string& Message)
         : error_code_(ErrCode), message_(Message){};
 
-    enum BST_EXCEPTION { E_OUT_BOUNDS, E_DUPLICATE, E_NO_MEMORY, E_NOT_FOUND };
+    enum BST_EXCEPTION { E_OUT_BOUNDS, E_DUPLICATE, E_NO_MEMORY, E_NOT_FOUND, E_NOT_SORTED };
 
     virtual int code() const { return error_code_; }
     virtual const char* what() const throw() { return message_.c_str(); }
@@ -42,8 +51,11 @@ class BSTException : public std::exception {
  *       It is a template class
  *       It is implemented using a linked structure
  *       It is not a balanced tree
+ * @tparam T Type of data
+ * @tparam Links Node layout: PointerLinks, or HandleLinks for nodes that
+ *               link their children by 32-bit handles (see BSTLinks.h)
  */
-template <typename T> 
+template <typename T, typename Links = PointerLinks>
 class BST {
   public:
     /**
@@ -53,40 +65,100 @@ class BST {
      */
 struct BinTreeNode
 {
-    BinTreeNode* left;
-    BinTreeNode* right;
+    typename Links::template Ptr<BinTreeNode> left;
+    typename Links::template Ptr<BinTreeNode> right;
     T data;
-    unsigned count;
-    int height_; // Added this line
+    unsigned count; // number of nodes in the subtree rooted here (kept up to date)
+    int height_; // height of the subtree rooted here, a leaf is 0 (kept up to date)
+    unsigned refs; // number of links (or roots) to this node, above 1 it is shared
 
     // default constructor
     BinTreeNode()
-        : left(nullptr), right(nullptr), data(0), count(0), height_(1) {}; // Updated this line
+        : left(nullptr), right(nullptr), data(0), count(1), height_(0), refs(1) {}; // Updated this line
 
     // constructor with data
     BinTreeNode(const T& value)
-        : left(nullptr), right(nullptr), data(value), count(0), height_(1) {}; // Updated this line
+        : left(nullptr), right(nullptr), data(value), count(1), height_(0), refs(1) {}; // Updated this line
     };
-    typedef BinTreeNode* BinTree; // BinTree is a pointer to BinTreeNode
+    typedef typename Links::template Ptr<BinTreeNode> BinTree; // BinTree refers to a BinTreeNode (a pointer, or a handle)
+    typedef std::vector<BinTree*> PathStack; // links walked from the root down
+
+    // nodes per page of the tree's own pool when no expected size is given
+    static const unsigned DEFAULT_NODES_PER_PAGE = 256;
 
     /**
      * @brief Default constructor
-     * @param allocator The allocator to be used
+     *        Nodes are placement-constructed in blocks of the allocator.
+     *        Without one, the tree creates its own pool of node-sized blocks,
+     *        which it shares with its copies and which goes with the last of them.
+     * @param allocator The allocator to be used (its object size must fit a
+     *                  node, and with HandleLinks it must use handles)
+     * @param expectedSize Nodes per page of the tree's own pool, so that a tree
+     *                     of this size fits on one page (0 for the default)
      */
-    BST(SimpleAllocator* allocator = nullptr);
+    BST(SimpleAllocator* allocator = nullptr, unsigned expectedSize = 0);
 
     /**
      * @brief Copy constructor
+     *        Deep, unless rhs is in copy-on-write mode: then the copy is O(1)
+     *        and shares rhs's nodes (see enableCopyOnWrite)
+     *        A deep copy of a tree with its own pool gets a new pool of the
+     *        same geometry, so the two can be used from different threads
      * @param rhs The BST to be copied
      */
     BST(const BST& rhs);
 
+    /**
+     * @brief Move constructor
+     *        O(1), it takes over rhs's nodes and allocator; rhs is left
+     *        empty (and still usable, sharing the allocator)
+     * @param rhs The BST to be moved from
+     */
+    BST(BST&& rhs) noexcept;
+
     /**
      * @brief Assignment operator
+     *        When both trees use the same allocator, or each its own pool,
+     *        the existing nodes are reused for the copy before any new one
+     *        is allocated; a tree sharing rhs's own pool gets a new one
+     *        If rhs is in copy-on-write mode, its nodes are shared instead
      * @param rhs The BST to be copied
      */
     BST& operator=(const BST& rhs);
 
+    /**
+     * @brief Move assignment operator
+     *        Our nodes are freed, then rhs's nodes and allocator are taken over
+     * @param rhs The BST to be moved from
+     */
+    BST& operator=(BST&& rhs) noexcept;
+
+    /**
+     * @brief Swap the contents and allocators of two trees in O(1)
+     * @param rhs The BST to swap with
+     */
+    void swap(BST& rhs) noexcept;
+
+    /**
+     * @brief Make copies of this tree share its nodes instead of copying them
+     *        Copying is then O(1): every node keeps a count of the links to
+     *        it, and an add/remove/split/... copies only the shared nodes it
+     *        would change, i.e. the O(log n) on its path. A snapshot thus
+     *        costs memory in proportion to the changes made since, not to
+     *        the size of the tree, and it never sees them.
+     *        The mode goes on to copies and to trees that take over nodes.
+     *        Snapshots may be read from other threads while this tree
+     *        changes, but they must be copied and destroyed on its thread
+     *        (the counts and the allocator are not synchronized).
+     */
+    void enableCopyOnWrite();
+
+    /**
+     * @brief Check if copies of the tree share its nodes
+     * @return true if the tree is in copy-on-write mode
+     */
+    bool copyOnWrite() const;
+
     /**
      * @brief Destructor
      *        It calls clear() to free all nodes
@@ -97,7 +169,7 @@ struct BinTreeNode
 
     /**
      * @brief Subscript operator thatreturns the node at the specified index.
-     *        It calls getNode_() to do the actual recursive traversal
+     *        It calls getNode_() to do the actual traversal
      * @param index The index of the node to be returned
      * @return The node at the specified index
      * @throw BSTException if the index is out of range
@@ -107,7 +179,7 @@ struct BinTreeNode
 
     /**
      * @brief Insert a value into the tree
-     *        It calls add_() to do the actual recursive insertion
+     *        It calls add_() to do the actual insertion
      *        It is virtual so that any derived class knows to override it
      * @param value The value to be added
      * @throw BSTException if the value already exists
@@ -116,7 +188,7 @@ struct BinTreeNode
 
     /**
      * @brief Remove a value from the tree
-     *        It calls remove_() to do the actual recursive removal
+     *        It calls remove_() to do the actual removal
      *        It is virtual so that any derived class knows to override it
      * @param value The value to be removed
      * @throw BSTException if the value does not exist
@@ -128,9 +200,48 @@ struct BinTreeNode
      */
     void clear();
 
+    /**
+     * @brief Replace the contents with a range of sorted values in O(n)
+     *        The tree is built perfectly balanced (so it is a valid AVL tree)
+     *        with every count and height set, and all the nodes are
+     *        allocated as one batch before any is linked in
+     * @param first Start of the range (forward iterators, it is read twice)
+     * @param last End of the range
+     * @throw BSTException if the range is not sorted (E_NOT_SORTED), has
+     *        duplicates the tree does not accept (E_DUPLICATE) or the
+     *        allocator runs out (E_NO_MEMORY); the tree is then unchanged
+     */
+    template <typename ForwardIt>
+    void buildFromSorted(ForwardIt first, ForwardIt last);
+
+    /**
+     * @brief Move the values less than key into left and the rest into right
+     *        Nodes are relinked, not copied, in O(height); this tree ends up
+     *        empty and both trees take over its allocator (their old
+     *        contents are cleared first)
+     * @param key The value to split at
+     * @param left The tree to get the values < key
+     * @param right The tree to get the values >= key
+     * @throw BSTException if left and right are the same tree
+     *        (E_NOT_SORTED, as for join); the trees are then unchanged
+     */
+    void split(const T& key, BST& left, BST& right);
+
+    /**
+     * @brief Replace the contents with the values of left followed by right
+     *        Nodes are relinked, not copied, in O(height) and both trees end
+     *        up empty. The tree takes over left's allocator; if right uses a
+     *        different one, right's nodes have to be copied over in O(|right|)
+     * @param left The tree with the smaller values
+     * @param right The tree with the larger values
+     * @throw BSTException if a value of left is not below every value of
+     *        right (E_NOT_SORTED); the trees are then unchanged
+     */
+    void join(BST& left, BST& right);
+
     /**
      * @brief Find a value in the tree
-     *        It calls find_() to do the actual recursive search
+     *        It calls find_() to do the actual search
      * @param value The value to be found
      * @param compares The number of comparisons made 
      *                 (a reference to provide as output)
@@ -139,6 +250,40 @@ struct BinTreeNode
      */
     bool find(const T& value, unsigned& compares) const;
 
+    /**
+     * @brief Export the values into an immutable array-based tree
+     *        Its find() walks a flat array instead of chasing pointers, for
+     *        when lookups vastly outnumber updates; later changes to this
+     *        tree do not show in it
+     * @param layout The layout of the array (see FrozenBST)
+     * @return The frozen tree, O(n) to build (O(n log n) for VAN_EMDE_BOAS)
+     */
+    FrozenBST<T> freeze(typename FrozenBST<T>::Layout layout = FrozenBST<T>::EYTZINGER) const;
+
+    /**
+     * @brief Count the values less than the given one, in O(log n)
+     *        from the cached subtree counts
+     * @param value The value to compare with
+     * @return The number of values < value (its index if it is in the tree)
+     */
+    unsigned rank(const T& value) const;
+
+    /**
+     * @brief Get the k-th smallest value (0-based), in O(log n)
+     * @param k The index of the value
+     * @return The value at index k
+     * @throw BSTException if k is out of range
+     */
+    const T& select(unsigned k) const;
+
+    /**
+     * @brief Count the values in [lo, hi], in O(log n)
+     * @param lo The smallest value of the range
+     * @param hi The largest value of the range
+     * @return The number of values v with lo <= v <= hi (0 if hi < lo)
+     */
+    unsigned countRange(const T& lo, const T& hi) const;
+
     /**
      * @brief Check if the tree is empty
      * @return true if the tree is empty
@@ -148,13 +293,14 @@ struct BinTreeNode
 
     /**
      * @brief Get the number of nodes in the tree
+     *        O(1), it is the root's cached count
      * @return The number of nodes in the tree
      */
     unsigned int size() const;
 
     /**
      * @brief Get the height of the tree
-     *        It calls height_() to do the actual recursive calculation
+     *        O(1), it is the root's cached height (-1 if empty)
      * @return The height of the tree
      */
     int height() const;
@@ -165,22 +311,125 @@ struct BinTreeNode
      */
     BinTree root() const;
 
+    /**
+     * @class const_iterator
+     * @brief Bidirectional in-order iterator over the values of the tree
+     *        It keeps the path of nodes from the root down to the current
+     *        node, so stepping never descends from the root again: ++/--
+     *        are amortized O(1) and a scan of k values after a lookup is
+     *        O(log n + k). (Nodes carry no parent pointers.)
+     *        Any add/remove/clear invalidates every iterator of the tree.
+     */
+    class const_iterator {
+      public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        /**
+         * @brief Construct an end iterator of no tree
+         */
+        const_iterator() : root_(nullptr) {}
+
+        reference operator*() const { return path_.back()->data; }
+        pointer operator->() const { return &path_.back()->data; }
+
+        /**
+         * @brief Step to the next value (from the last value to end())
+         */
+        const_iterator& operator++();
+        const_iterator operator++(int) { const_iterator old(*this); ++*this; return old; }
+
+        /**
+         * @brief Step to the previous value (from end() to the last value)
+         */
+        const_iterator& operator--();
+        const_iterator operator--(int) { const_iterator old(*this); --*this; return old; }
+
+        bool operator==(const const_iterator& rhs) const {
+            return current() == rhs.current();
+        }
+        bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+
+      private:
+        friend class BST;
+
+        // the current node, nullptr at end()
+        BinTree current() const { return path_.empty() ? nullptr : path_.back(); }
+
+        // go down the leftmost (or rightmost) path from the back of path_
+        void descend(bool leftmost);
+
+        BinTree root_; // root of the tree, to step back from end()
+        std::vector<BinTree> path_; // nodes from the root down to the current one
+    };
+    typedef const_iterator iterator; // values cannot change in place, that would break the order
+
+    /**
+     * @brief Get an iterator to the smallest value
+     * @return begin iterator (end() if the tree is empty)
+     */
+    const_iterator begin() const;
+
+    /**
+     * @brief Get the iterator past the largest value
+     * @return end iterator
+     */
+    const_iterator end() const;
+
+    /**
+     * @brief Find the first value not less than the given one, in O(log n)
+     * @param value The value to compare with
+     * @return iterator to the first value >= value (end() if none)
+     */
+    const_iterator lower_bound(const T& value) const;
+
+    /**
+     * @brief Find the first value greater than the given one, in O(log n)
+     * @param value The value to compare with
+     * @return iterator to the first value > value (end() if none)
+     */
+    const_iterator upper_bound(const T& value) const;
+
+    /**
+     * @brief Get the range of values equal to the given one
+     * @param value The value to compare with
+     * @return pair of lower_bound(value) and upper_bound(value)
+     */
+    std::pair<const_iterator, const_iterator> equal_range(const T& value) const;
+
+    /**
+     * @brief Call fn on every value in [lo, hi], in order, in O(log n + k)
+     * @param lo The smallest value of the range
+     * @param hi The largest value of the range
+     * @param fn Callable taking a const T&
+     */
+    template <typename Fn>
+    void forEachInRange(const T& lo, const T& hi, Fn fn) const {
+        for (const_iterator it = lower_bound(lo); it != end() && !(hi < *it); ++it)
+            fn(*it);
+    }
+
   protected:
 
     /**
-     * @brief Allocate a new node
+     * @brief Allocate a new node from the allocator and construct it in place
      * @param value The value to be stored in the new node
+     * @throw BSTException if the allocator is out of memory
      */
     BinTree makeNode(const T& value);
 
     /**
-     * @brief Free a node
+     * @brief Destroy a node and return its block to the allocator
      * @param node The node to be freed
      */
     void freeNode(BinTree node);
 
     /**
-     * @brief Calculate the height of the tree
+     * @brief Calculate the height of the tree by walking the whole subtree
+     *        O(n) with an explicit stack, it also refreshes every cached height
      * @param tree The tree to be calculated
      */
     int treeHeight(BinTree tree) const;
@@ -208,8 +457,150 @@ struct BinTreeNode
      *         false otherwise
      */
     bool isLeaf(const BinTree& tree) const;
+
+    /**
+     * @brief Get the size of a subtree from its cached count
+     * @param tree The subtree
+     * @return The number of nodes in the subtree (0 if empty)
+     */
+    unsigned size_(const BinTree& tree) const;
+
+    /**
+     * @brief Recompute a node's cached count and height from its children
+     *        It must be called bottom-up whenever a node's children change
+     * @param tree The node to update
+     */
+    void updateStats(BinTree tree);
+
     // Accessor to get a reference to root_
     BinTree& rootRef() { return root_; }
+
+    /**
+     * @brief Walk down to the node holding a value, pushing every link passed
+     *        All the tree operations are iterative so that degenerate trees
+     *        (e.g. sorted input) cannot overflow the call stack
+     *        If the value is there, the nodes passed are made ours alone
+     *        (see unsharePath_) as they are about to change; a miss copies
+     *        nothing
+     * @param tree The link to start from
+     * @param value The value to look for
+     * @param path The links from tree down to the node (the last one is
+     *             the node's own link, which is nullptr if not found)
+     */
+    void findPath_(BinTree& tree, const T& value, PathStack& path);
+
+    /**
+     * @brief Make the node a link points to ours alone before changing it
+     *        A shared node is replaced by a copy that shares its children
+     *        instead (path copying), so the other trees never see the change
+     * @param tree The link, which we hold one reference of
+     * @throw BSTException if the allocator is out of memory
+     */
+    void unshare_(BinTree& tree);
+
+    /**
+     * @brief Make the nodes of a path found by a read-only walk ours alone
+     *        Walks are read-only so that an add or remove that fails (a
+     *        duplicate, a missing value) copies no shared node; this does the
+     *        copying once the change is known to go ahead
+     * @param path The links from the root down; each link after the first
+     *             is a child link of the node before it, and is moved into
+     *             that node's copy if it gets one
+     * @throw BSTException if the allocator is out of memory
+     */
+    void unsharePath_(PathStack& path);
+
+    /**
+     * @brief Unlink and free the node the last link of the path points to
+     *        A node with two children takes its predecessor's value and the
+     *        predecessor is unlinked instead, so the path is extended to it
+     *        Afterwards the nodes on the path still need their stats updated
+     * @param path The links from the root down to the node
+     */
+    void unlinkPath_(PathStack& path);
+
+    // scratch stack of links reused by add/remove so they do not allocate
+    PathStack path_;
+
+    /**
+     * @brief Whether equal values may be stored (the plain BST rejects them)
+     * @return false, a derived tree that accepts them overrides this
+     */
+    virtual bool acceptsDuplicates() const { return false; }
+
+    /**
+     * @brief Join two subtrees with a node whose value lies between them
+     *        The plain BST just hangs them off the node, a balanced tree
+     *        overrides this to keep its balance
+     * @param left The subtree of smaller values
+     * @param node The node in between
+     * @param right The subtree of larger values
+     * @return The root of the joined subtree
+     */
+    virtual BinTree join3_(BinTree left, BinTree node, BinTree right);
+
+    /**
+     * @brief Update the nodes of a path bottom-up after a node below changed
+     *        The plain BST refreshes their stats, a balanced tree overrides
+     *        this to also rebalance them
+     * @param path The links from the root down, emptied on return
+     */
+    virtual void fixPath_(PathStack& path);
+
+    /**
+     * @brief Split a subtree at a key into the values below it and the rest
+     *        It walks down once and joins the pieces back bottom-up
+     * @param tree The subtree, which is taken apart
+     * @param key The value to split at
+     * @param inclusive Whether the values equal to key go left too
+     * @param left The subtree of values < key (<= key if inclusive)
+     * @param right The subtree of the other values
+     */
+    void split_(BinTree tree, const T& key, bool inclusive, BinTree& left, BinTree& right);
+
+    /**
+     * @brief Join two subtrees, every value of left being below those of right
+     * @param left The subtree of smaller values
+     * @param right The subtree of larger values
+     * @return The root of the joined subtree
+     */
+    BinTree join2_(BinTree left, BinTree right);
+
+    /**
+     * @brief Take the nodes of another tree, which ends up empty
+     *        They are relinked if it uses our allocator, copied otherwise
+     * @param other The tree to take the nodes of
+     * @return The root of the nodes taken
+     */
+    BinTree takeNodes_(BST& other);
+
+    /**
+     * @brief Free every node of the tree
+     *        Left children are rotated up until the node has none, so this
+     *        needs neither recursion nor a stack
+     *        A shared subtree is only let go of, the other trees keep it
+     * @param tree The tree to be cleared
+     * @param spare If given, the nodes are only destroyed and their blocks
+     *              are kept here for reuse instead of being freed
+     */
+    void clear_(BinTree& tree, std::vector<BinTree>* spare = nullptr);
+
+    /**
+     * @brief Whether a value goes to the left side of a split at key
+     * @param value The value
+     * @param key The value to split at
+     * @param inclusive Whether the values equal to key go left too
+     * @return true if value < key (value <= key if inclusive)
+     */
+    static bool goesLeft_(const T& value, const T& key, bool inclusive) {
+        return inclusive ? !(key < value) : value < key;
+    }
+
+    /**
+     * @brief Get the height of a subtree from its cached height
+     * @param tree The subtree
+     * @return The height of the subtree (-1 if empty)
+     */
     int height_(const BinTree& tree) const;
     // ... rest of the protected members ...
 
@@ -218,21 +609,34 @@ struct BinTreeNode
     // the allocator to be used
     SimpleAllocator* allocator_;
 
-    // whether the allocator is owned by the tree
-    bool isOwnAllocator_ = false;
+    // the pool created when no allocator was passed in, shared with the
+    // copy-on-write copies and the trees that take over nodes (split, join,
+    // set operations); a deep copy gets a pool of its own
+    std::shared_ptr<SimpleAllocator> ownAllocator_;
+
+    /**
+     * @brief Create a pool of node-sized blocks for a tree without allocator
+     * @param nodesPerPage Nodes per page (at most what a handle can address
+     *                     with HandleLinks)
+     * @return The pool
+     */
+    static std::shared_ptr<SimpleAllocator> makeOwnAllocator_(unsigned nodesPerPage);
 
     // the root of the tree
     BinTree root_;
 
+    // whether copies share the nodes (see enableCopyOnWrite)
+    bool copyOnWrite_;
+
     /**
-     * @brief A recursive step to add a value into the tree
+     * @brief Add a value into the tree (iterative)
      * @param tree The tree to be added
      * @param value The value to be added
      */
     void add_(BinTree& tree, const T& value);
 
     /**
-     * @brief A recursive step to find the value in the tree
+     * @brief Find the value in the tree (iterative)
      * @param tree The tree to be searched
      * @param value The value to be found
      * @param compares The number of comparisons made
@@ -243,7 +647,7 @@ struct BinTreeNode
     bool find_(const BinTree& tree, const T& value, unsigned& compares) const;
 
     /**
-     * @brief A recursive step to get to the node at the specified index
+     * @brief Get to the node at the specified index (iterative)
      *        This is used by operator[]
      * @param tree The tree to be traversed
      * @param index The index of the node to be returned
@@ -253,34 +657,40 @@ struct BinTreeNode
      const BinTree getNode_(const BinTree& tree, int index) const;
 
     /**
-     * @brief A recursive step to calculate the size of the tree
-     * @param tree The tree to be calculated
-     * @return The size of the tree
-     */
-    unsigned size_(const BinTree& tree) const;
-
-    /**
-     * @brief A recursive step to remove a value from the tree
+     * @brief Remove a value from the tree (iterative)
      * @param tree The tree to be removed
      * @param value The value to be removed
      */
     void remove_(BinTree& tree, const T& value);
 
     /**
-     * @brief A recursive step to calculate the height of the tree
-     * @param tree The tree to be calculated
-     * @return The height of the tree
+     * @brief Copy the tree (iterative, with an explicit stack)
+     * @param tree The tree to be copied
+     * @param rtree The tree to be copied to
+     * @param spare If given, blocks to construct nodes in before allocating
      */
+    void copy_(BinTree& tree, const BinTree& rtree, std::vector<BinTree>* spare = nullptr);
 
+    /**
+     * @brief Count the values less than (or not greater than) a value
+     * @param value The value to compare with
+     * @param inclusive Whether to count the values equal to it too
+     * @return The number of values < value (<= value if inclusive)
+     */
+    unsigned rank_(const T& value, bool inclusive) const;
 
     /**
-     * @brief A recursive step to copy the tree 
-     * @param tree The tree to be copied
-     * @param rtree The tree to be copied to
+     * @brief Build a balanced tree of the next n values, in order
+     *        The recursion only goes log2(n) deep
+     * @param it The next value, advanced past the n values
+     * @param n The number of values
+     * @param blocks The preallocated node blocks
+     * @param next The next unused block, advanced past the n nodes
+     * @return The root of the new subtree
      */
-    void copy_(BinTree& tree, const BinTree& rtree);
- 
-    void clear_(BinTree& tree);
+    template <typename ForwardIt>
+    BinTree buildBalanced_(ForwardIt& it, size_t n, const std::vector<BinTree>& blocks, size_t& next);
+
 };
 
 // This is the header file but it is including the implemention cpp because
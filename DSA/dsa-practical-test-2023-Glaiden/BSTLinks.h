@@ -0,0 +1,124 @@
+/**
+ * @file BSTLinks.h
+ * @brief Node layouts of BST/AVL: how a node refers to its children
+ *        - PointerLinks: plain pointers (the default)
+ *        - HandleLinks: 32-bit SimpleAllocator handles, which make a
+ *          BST<int> node 24 bytes instead of 32 on a 64-bit machine
+ * @date 19 Oct 2026
+ */
+#ifndef BSTLINKS_H
+#define BSTLINKS_H
+#include "SimpleAllocator.h"
+#include <cstddef>
+
+/**
+ * @struct PointerLinks
+ * @brief Node layout where the children (and every node reference of the
+ *        tree) are pointers
+ */
+struct PointerLinks {
+    // a reference to a node
+    template <typename Node>
+    using Ptr = Node*;
+
+    // whether the pool the nodes come from must hand out handles
+    static const bool USES_HANDLES = false;
+
+    /**
+     * @brief Get a block for a node (still to be constructed) from a pool
+     * @param allocator The pool
+     * @return The block
+     * @throw SimpleAllocatorException if the pool is out of memory
+     */
+    template <typename Node>
+    static Node* allocate(SimpleAllocator& allocator) {
+        return static_cast<Node*>(allocator.allocate());
+    }
+
+    /**
+     * @brief Give the block of a (destroyed) node back to its pool
+     * @param allocator The pool
+     * @param block The block
+     */
+    template <typename Node>
+    static void free(SimpleAllocator& allocator, Node* block) {
+        allocator.free(block);
+    }
+};
+
+/**
+ * @struct HandleLinks
+ * @brief Node layout where the children (and every node reference of the
+ *        tree) are 32-bit handles of the pool the nodes come from
+ *        A handle is resolved through the table of pages that all handle
+ *        pools share (SimpleAllocator::resolve), so it needs no tree or
+ *        allocator at hand and behaves like a pointer: ->, *, comparisons
+ *        and conversion to the node pointer all work. Following one costs
+ *        a lookup in that table, which the smaller nodes pay for by
+ *        fitting more of the tree in the cache.
+ */
+struct HandleLinks {
+    // a reference to a node
+    template <typename Node>
+    class Ptr {
+      public:
+        Ptr() : handle_(SimpleAllocator::NULL_HANDLE) {}
+        Ptr(std::nullptr_t) : handle_(SimpleAllocator::NULL_HANDLE) {}
+
+        /**
+         * @brief Refer to the node a handle refers to
+         * @param handle The handle (NULL_HANDLE for no node)
+         * @return The reference
+         */
+        static Ptr fromHandle(SimpleAllocator::Handle handle) {
+            Ptr ptr;
+            ptr.handle_ = handle;
+            return ptr;
+        }
+
+        // the handle
+        SimpleAllocator::Handle handle() const { return handle_; }
+
+        // the node, nullptr if none
+        Node* get() const { return static_cast<Node*>(SimpleAllocator::resolve(handle_)); }
+        operator Node*() const { return get(); }
+        Node* operator->() const { return get(); }
+        Node& operator*() const { return *get(); }
+
+        bool operator==(const Ptr& rhs) const { return handle_ == rhs.handle_; }
+        bool operator!=(const Ptr& rhs) const { return handle_ != rhs.handle_; }
+        bool operator==(std::nullptr_t) const { return handle_ == SimpleAllocator::NULL_HANDLE; }
+        bool operator!=(std::nullptr_t) const { return handle_ != SimpleAllocator::NULL_HANDLE; }
+        bool operator!() const { return handle_ == SimpleAllocator::NULL_HANDLE; }
+
+      private:
+        SimpleAllocator::Handle handle_;
+    };
+
+    // whether the pool the nodes come from must hand out handles
+    static const bool USES_HANDLES = true;
+
+    /**
+     * @brief Get a block for a node (still to be constructed) from a pool
+     * @param allocator The pool, which must use handles
+     * @return The block
+     * @throw SimpleAllocatorException if the pool is out of memory or
+     *        does not use handles
+     */
+    template <typename Node>
+    static Ptr<Node> allocate(SimpleAllocator& allocator) {
+        return Ptr<Node>::fromHandle(allocator.allocateHandle());
+    }
+
+    /**
+     * @brief Give the block of a (destroyed) node back to its pool
+     * @param allocator The pool
+     * @param block The block
+     */
+    template <typename Node>
+    static void free(SimpleAllocator& allocator, Ptr<Node> block) {
+        allocator.freeHandle(block.handle());
+    }
+};
+
+#endif
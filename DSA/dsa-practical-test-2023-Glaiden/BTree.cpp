@@ -0,0 +1,516 @@
+#include "BTree.h"
+#include <algorithm>
+#include <climits>
+#include <new>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Constructor
+template <typename T, unsigned B>
+BTree<T, B>::BTree(unsigned expectedSize) : root_(nullptr), size_(0), height_(-1) {
+    // nodes are at least MIN_KEYS full, and there are about B times fewer
+    // internal nodes than leaves
+    unsigned leavesPerPage = expectedSize > 0 ? expectedSize / MIN_KEYS + 1 : DEFAULT_NODES_PER_PAGE;
+    unsigned internalPerPage = expectedSize > 0 ? leavesPerPage / MIN_KEYS + 1 : DEFAULT_NODES_PER_PAGE;
+    SimpleAllocatorConfig::HeaderBlockInfo noHeader;
+    leafAllocator_ = std::make_shared<SimpleAllocator>(
+        sizeof(BTreeNode), SimpleAllocatorConfig(false, leavesPerPage, UINT_MAX, noHeader, BTREE_CACHE_LINE));
+    internalAllocator_ = std::make_shared<SimpleAllocator>(
+        sizeof(BTreeInternal), SimpleAllocatorConfig(false, internalPerPage, UINT_MAX, noHeader, BTREE_CACHE_LINE));
+}
+
+// Copy constructor
+template <typename T, unsigned B>
+BTree<T, B>::BTree(const BTree& rhs)
+    : root_(nullptr), size_(0), height_(-1), leafAllocator_(rhs.leafAllocator_), internalAllocator_(rhs.internalAllocator_) {
+    root_ = copy_(rhs.root_);
+    size_ = rhs.size_;
+    height_ = rhs.height_;
+}
+
+// Move constructor
+template <typename T, unsigned B>
+BTree<T, B>::BTree(BTree&& rhs) noexcept
+    : root_(rhs.root_), size_(rhs.size_), height_(rhs.height_),
+      leafAllocator_(rhs.leafAllocator_), internalAllocator_(rhs.internalAllocator_) {
+    rhs.root_ = nullptr;
+    rhs.size_ = 0;
+    rhs.height_ = -1;
+}
+
+// Assignment operator
+template <typename T, unsigned B>
+BTree<T, B>& BTree<T, B>::operator=(const BTree& rhs) {
+    if (this != &rhs) {
+        clear(); // the nodes go back to the old pools before they are let go
+        leafAllocator_ = rhs.leafAllocator_;
+        internalAllocator_ = rhs.internalAllocator_;
+        root_ = copy_(rhs.root_);
+        size_ = rhs.size_;
+        height_ = rhs.height_;
+    }
+    return *this;
+}
+
+// Move assignment operator
+template <typename T, unsigned B>
+BTree<T, B>& BTree<T, B>::operator=(BTree&& rhs) noexcept {
+    if (this != &rhs) {
+        clear();
+        leafAllocator_ = rhs.leafAllocator_;
+        internalAllocator_ = rhs.internalAllocator_;
+        root_ = rhs.root_;
+        size_ = rhs.size_;
+        height_ = rhs.height_;
+        rhs.root_ = nullptr;
+        rhs.size_ = 0;
+        rhs.height_ = -1;
+    }
+    return *this;
+}
+
+// Destructor
+template <typename T, unsigned B>
+BTree<T, B>::~BTree() {
+    clear();
+}
+
+// Subscript operator
+// - the children's sizes tell which one holds the index
+template <typename T, unsigned B>
+const T& BTree<T, B>::operator[](int index) const {
+    if (index < 0 || static_cast<unsigned>(index) >= size_) {
+        throw BSTException(BSTException::E_OUT_BOUNDS, "Index out of bounds");
+    }
+    unsigned rest = index;
+    const BTreeNode* node = root_;
+    while (!node->leaf) {
+        const BTreeInternal* parent = static_cast<const BTreeInternal*>(node);
+        unsigned i = 0;
+        for (;; ++i) {
+            unsigned childSize = subtreeSize_(parent->children[i]);
+            if (rest < childSize) {
+                break;
+            }
+            rest -= childSize;
+            if (rest == 0) {
+                return parent->keys[i]; // the value right after child i
+            }
+            --rest;
+        }
+        node = parent->children[i];
+    }
+    return node->keys[rest];
+}
+
+// Insert a value into the tree
+template <typename T, unsigned B>
+void BTree<T, B>::add(const T& value) {
+    unsigned compares = 0;
+    if (find(value, compares)) {
+        throw BSTException(BSTException::E_DUPLICATE, "Value already exists in the tree");
+    }
+    if (root_ == nullptr) {
+        root_ = makeNode_(true);
+        height_ = 0;
+    } else if (root_->count == B) {
+        // the root splits in two, the tree grows a level at the top
+        BTreeInternal* root = internal_(makeNode_(false));
+        root->children[0] = root_;
+        root->size = size_;
+        try {
+            splitChild_(root, 0);
+        } catch (...) {
+            freeNode_(root);
+            throw;
+        }
+        root_ = root;
+        ++height_;
+    }
+
+    // walk down, splitting the full children before going into them
+    path_.clear();
+    BTreeNode* node = root_;
+    while (!node->leaf) {
+        BTreeInternal* parent = internal_(node);
+        unsigned i = rank_(parent, value);
+        if (parent->children[i]->count == B) {
+            splitChild_(parent, i);
+            if (parent->keys[i] < value) {
+                ++i;
+            }
+        }
+        path_.push_back(parent);
+        node = parent->children[i];
+    }
+    unsigned i = rank_(node, value);
+    std::move_backward(node->keys + i, node->keys + node->count, node->keys + node->count + 1);
+    node->keys[i] = value;
+    ++node->count;
+
+    // one more value below every node on the path
+    for (BTreeInternal* parent : path_) {
+        ++parent->size;
+    }
+    ++size_;
+}
+
+// Remove a value from the tree
+template <typename T, unsigned B>
+void BTree<T, B>::remove(const T& value) {
+    unsigned compares = 0;
+    if (!find(value, compares)) {
+        throw BSTException(BSTException::E_NOT_FOUND, "Value to remove not found in the tree");
+    }
+
+    // walk down, refilling the minimal children before going into them
+    path_.clear();
+    T target = value;
+    BTreeNode* node = root_;
+    while (!node->leaf) {
+        BTreeInternal* parent = internal_(node);
+        unsigned i = rank_(parent, target);
+        if (i < parent->count && !(target < parent->keys[i])) {
+            // the value is here: its predecessor (or successor) takes its
+            // place and is removed from its leaf instead, unless both
+            // children are minimal and get merged around it
+            BTreeNode* left = parent->children[i];
+            BTreeNode* right = parent->children[i + 1];
+            if (left->count > MIN_KEYS) {
+                while (!left->leaf) {
+                    left = internal_(left)->children[left->count];
+                }
+                target = left->keys[left->count - 1];
+                parent->keys[i] = target;
+            } else if (right->count > MIN_KEYS) {
+                while (!right->leaf) {
+                    right = internal_(right)->children[0];
+                }
+                target = right->keys[0];
+                parent->keys[i] = target;
+                ++i;
+            } else {
+                mergeChildren_(parent, i);
+            }
+        } else {
+            i = fillChild_(parent, i);
+        }
+
+        node = parent->children[i];
+        if (parent == root_ && parent->count == 0) {
+            // the root's last value moved down, the tree shrinks a level at the top
+            root_ = node;
+            freeNode_(parent);
+            --height_;
+        } else {
+            path_.push_back(parent);
+        }
+    }
+    unsigned i = rank_(node, target);
+    std::move(node->keys + i + 1, node->keys + node->count, node->keys + i);
+    --node->count;
+
+    // one value less below every node on the path
+    for (BTreeInternal* parent : path_) {
+        --parent->size;
+    }
+    --size_;
+    if (size_ == 0) {
+        clear();
+    }
+}
+
+// Remove all values in the tree
+template <typename T, unsigned B>
+void BTree<T, B>::clear() {
+    clear_(root_);
+    root_ = nullptr;
+    size_ = 0;
+    height_ = -1;
+}
+
+// Find a value in the tree
+template <typename T, unsigned B>
+bool BTree<T, B>::find(const T& value, unsigned& compares) const {
+    const BTreeNode* node = root_;
+    while (node != nullptr) {
+        compares++; // one search of a node
+        unsigned i = rank_(node, value);
+        if (i < node->count && !(value < node->keys[i])) {
+            return true;
+        }
+        node = node->leaf ? nullptr : static_cast<const BTreeInternal*>(node)->children[i];
+    }
+    return false;
+}
+
+// Check if the tree is empty
+template <typename T, unsigned B>
+bool BTree<T, B>::empty() const {
+    return root_ == nullptr;
+}
+
+// Get the number of values in the tree
+template <typename T, unsigned B>
+unsigned int BTree<T, B>::size() const {
+    return size_;
+}
+
+// Get the height of the tree
+template <typename T, unsigned B>
+int BTree<T, B>::height() const {
+    return height_;
+}
+
+// Count the values of a node less than the given one
+// - every value is compared, then only the ones in use are counted, so
+//   there is no branch on the comparisons
+template <typename T, unsigned B>
+unsigned BTree<T, B>::rank_(const BTreeNode* node, const T& value) {
+    unsigned count = node->count;
+#if defined(__SSE2__)
+    // one bit per value less than value; the keys start on the cache line,
+    // so the vectors are aligned, and the last one may read past the keys
+    // but not past the node
+    if constexpr (B < 64 && std::is_same<T, int>::value) {
+        __m128i v = _mm_set1_epi32(value);
+        unsigned long long less = 0;
+        for (unsigned i = 0; i < B; i += 4) {
+            __m128i keys = _mm_load_si128(reinterpret_cast<const __m128i*>(node->keys + i));
+            less |= static_cast<unsigned long long>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(keys, v)))) << i;
+        }
+        return __builtin_popcountll(less & ((1ULL << count) - 1));
+    } else if constexpr (B < 64 && std::is_same<T, float>::value) {
+        __m128 v = _mm_set1_ps(value);
+        unsigned long long less = 0;
+        for (unsigned i = 0; i < B; i += 4) {
+            less |= static_cast<unsigned long long>(_mm_movemask_ps(_mm_cmplt_ps(_mm_load_ps(node->keys + i), v))) << i;
+        }
+        return __builtin_popcountll(less & ((1ULL << count) - 1));
+    } else if constexpr (B < 64 && std::is_same<T, double>::value) {
+        __m128d v = _mm_set1_pd(value);
+        unsigned long long less = 0;
+        for (unsigned i = 0; i < B; i += 2) {
+            less |= static_cast<unsigned long long>(_mm_movemask_pd(_mm_cmplt_pd(_mm_load_pd(node->keys + i), v))) << i;
+        }
+        return __builtin_popcountll(less & ((1ULL << count) - 1));
+    }
+#endif
+    if constexpr (std::is_arithmetic<T>::value) {
+        // the same count with a fixed trip count, which the compiler can vectorize
+        unsigned rank = 0;
+        for (unsigned i = 0; i < B; ++i) {
+            rank += (i < count) & (node->keys[i] < value);
+        }
+        return rank;
+    } else {
+        return std::lower_bound(node->keys, node->keys + count, value) - node->keys;
+    }
+}
+
+// Get the number of values in a subtree
+template <typename T, unsigned B>
+unsigned BTree<T, B>::subtreeSize_(const BTreeNode* node) {
+    return node->leaf ? node->count : static_cast<const BTreeInternal*>(node)->size;
+}
+
+// Access a node as an internal node
+template <typename T, unsigned B>
+typename BTree<T, B>::BTreeInternal* BTree<T, B>::internal_(BTreeNode* node) {
+    return static_cast<BTreeInternal*>(node);
+}
+
+// Allocate a new node
+template <typename T, unsigned B>
+typename BTree<T, B>::BTreeNode* BTree<T, B>::makeNode_(bool leaf) {
+    SimpleAllocator* allocator = leaf ? leafAllocator_.get() : internalAllocator_.get();
+    void* mem = nullptr;
+    try {
+        mem = allocator->allocate();
+    } catch (const SimpleAllocatorException& e) {
+        throw BSTException(BSTException::E_NO_MEMORY, e.what());
+    }
+    try {
+        if (leaf) {
+            return new (mem) BTreeNode(true);
+        }
+        return new (mem) BTreeInternal();
+    } catch (...) {
+        // T's default constructor threw, give the block back
+        allocator->free(mem);
+        throw;
+    }
+}
+
+// Free a node
+template <typename T, unsigned B>
+void BTree<T, B>::freeNode_(BTreeNode* node) {
+    if (node->leaf) {
+        node->~BTreeNode();
+        leafAllocator_->free(node);
+    } else {
+        BTreeInternal* internal = internal_(node);
+        internal->~BTreeInternal();
+        internalAllocator_->free(internal);
+    }
+}
+
+// Split the full child i of a node around its middle value
+template <typename T, unsigned B>
+void BTree<T, B>::splitChild_(BTreeInternal* parent, unsigned i) {
+    BTreeNode* child = parent->children[i];
+    BTreeNode* sibling = makeNode_(child->leaf); // first, so a failure changes nothing
+    const unsigned middle = B / 2;
+
+    // the values after the middle one go to the new sibling
+    sibling->count = B - 1 - middle;
+    std::move(child->keys + middle + 1, child->keys + B, sibling->keys);
+    if (!child->leaf) {
+        BTreeInternal* left = internal_(child);
+        BTreeInternal* right = internal_(sibling);
+        std::copy(left->children + middle + 1, left->children + B + 1, right->children);
+        right->size = right->count;
+        for (unsigned j = 0; j <= right->count; ++j) {
+            right->size += subtreeSize_(right->children[j]);
+        }
+        left->size -= right->size + 1;
+    }
+    child->count = middle;
+
+    // the middle value moves up between the two halves
+    std::move_backward(parent->keys + i, parent->keys + parent->count, parent->keys + parent->count + 1);
+    std::copy_backward(parent->children + i + 1, parent->children + parent->count + 1, parent->children + parent->count + 2);
+    parent->keys[i] = std::move(child->keys[middle]);
+    parent->children[i + 1] = sibling;
+    ++parent->count;
+}
+
+// Make sure child i of a node has more than MIN_KEYS values
+template <typename T, unsigned B>
+unsigned BTree<T, B>::fillChild_(BTreeInternal* parent, unsigned i) {
+    BTreeNode* child = parent->children[i];
+    if (child->count > MIN_KEYS) {
+        return i;
+    }
+    if (i > 0 && parent->children[i - 1]->count > MIN_KEYS) {
+        // rotate the left sibling's last value through the parent
+        BTreeNode* sibling = parent->children[i - 1];
+        std::move_backward(child->keys, child->keys + child->count, child->keys + child->count + 1);
+        child->keys[0] = std::move(parent->keys[i - 1]);
+        parent->keys[i - 1] = std::move(sibling->keys[sibling->count - 1]);
+        if (!child->leaf) {
+            BTreeInternal* to = internal_(child);
+            BTreeInternal* from = internal_(sibling);
+            std::copy_backward(to->children, to->children + to->count + 1, to->children + to->count + 2);
+            to->children[0] = from->children[from->count];
+            unsigned moved = 1 + subtreeSize_(to->children[0]);
+            to->size += moved;
+            from->size -= moved;
+        }
+        ++child->count;
+        --sibling->count;
+        return i;
+    }
+    if (i < parent->count && parent->children[i + 1]->count > MIN_KEYS) {
+        // rotate the right sibling's first value through the parent
+        BTreeNode* sibling = parent->children[i + 1];
+        child->keys[child->count] = std::move(parent->keys[i]);
+        parent->keys[i] = std::move(sibling->keys[0]);
+        std::move(sibling->keys + 1, sibling->keys + sibling->count, sibling->keys);
+        if (!child->leaf) {
+            BTreeInternal* to = internal_(child);
+            BTreeInternal* from = internal_(sibling);
+            to->children[to->count + 1] = from->children[0];
+            std::copy(from->children + 1, from->children + from->count + 1, from->children);
+            unsigned moved = 1 + subtreeSize_(to->children[to->count + 1]);
+            to->size += moved;
+            from->size -= moved;
+        }
+        ++child->count;
+        --sibling->count;
+        return i;
+    }
+    // both siblings are minimal too, merge with one of them
+    if (i < parent->count) {
+        mergeChildren_(parent, i);
+        return i;
+    }
+    mergeChildren_(parent, i - 1);
+    return i - 1;
+}
+
+// Merge child i + 1 of a node and the value between them into child i
+template <typename T, unsigned B>
+void BTree<T, B>::mergeChildren_(BTreeInternal* parent, unsigned i) {
+    BTreeNode* left = parent->children[i];
+    BTreeNode* right = parent->children[i + 1];
+    left->keys[left->count] = std::move(parent->keys[i]);
+    std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+    if (!left->leaf) {
+        BTreeInternal* to = internal_(left);
+        BTreeInternal* from = internal_(right);
+        std::copy(from->children, from->children + from->count + 1, to->children + to->count + 1);
+        to->size += 1 + from->size;
+    }
+    left->count += 1 + right->count;
+
+    std::move(parent->keys + i + 1, parent->keys + parent->count, parent->keys + i);
+    std::copy(parent->children + i + 2, parent->children + parent->count + 1, parent->children + i + 1);
+    --parent->count;
+    freeNode_(right);
+}
+
+// Free every node of a subtree, with an explicit stack
+template <typename T, unsigned B>
+void BTree<T, B>::clear_(BTreeNode* node) {
+    std::vector<BTreeNode*> stack;
+    if (node != nullptr) {
+        stack.push_back(node);
+    }
+    while (!stack.empty()) {
+        node = stack.back();
+        stack.pop_back();
+        if (!node->leaf) {
+            BTreeInternal* parent = internal_(node);
+            stack.insert(stack.end(), parent->children, parent->children + parent->count + 1);
+        }
+        freeNode_(node);
+    }
+}
+
+// Copy a subtree
+template <typename T, unsigned B>
+typename BTree<T, B>::BTreeNode* BTree<T, B>::copy_(const BTreeNode* node) {
+    if (node == nullptr) {
+        return nullptr;
+    }
+    BTreeNode* copy = makeNode_(node->leaf);
+    try {
+        std::copy(node->keys, node->keys + node->count, copy->keys);
+        if (!node->leaf) {
+            const BTreeInternal* source = static_cast<const BTreeInternal*>(node);
+            BTreeInternal* target = internal_(copy);
+            for (unsigned i = 0; i <= node->count; ++i) {
+                target->children[i] = copy_(source->children[i]);
+            }
+            target->size = source->size;
+        }
+        copy->count = node->count;
+    } catch (...) {
+        if (!copy->leaf) {
+            // the children not copied yet are still nullptr
+            BTreeInternal* target = internal_(copy);
+            for (BTreeNode* child : target->children) {
+                clear_(child);
+            }
+        }
+        freeNode_(copy);
+        throw;
+    }
+    return copy;
+}
+
+// Explicit instantiation for the types you plan to use
+template class BTree<int>;
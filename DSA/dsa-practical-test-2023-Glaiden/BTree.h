@@ -0,0 +1,279 @@
+/**
+ * @file BTree.h
+ * @brief BTree class definition
+ *        A B-tree with the public interface of the BST, for large sets
+ *        where the two pointers per value of a binary node waste the cache
+ * @date 19 Oct 2026
+ */
+#ifndef BTREE_H
+#define BTREE_H
+#include "SimpleAllocator.h" // the nodes come from SimpleAllocator pools
+#include "BST.h" // for BSTException, so the BTree throws what the BST does
+#include <memory>
+#include <vector>
+
+// size of a cache line, which the nodes are sized and aligned to
+static const unsigned BTREE_CACHE_LINE = 64;
+
+/**
+ * @brief Default number of values per node: as many as fit in one cache
+ *        line next to the node's value count and leaf flag (at least 3)
+ * @tparam T Type of data
+ */
+template <typename T>
+constexpr unsigned btreeDefaultOrder() {
+    return (BTREE_CACHE_LINE - 4) / sizeof(T) >= 3 ? (BTREE_CACHE_LINE - 4) / sizeof(T) : 3;
+}
+
+/**
+ * @class BTree
+ * @brief B-tree class
+ *       It is a template class with the public interface of BST<T>
+ *       (add, remove, find with compares, operator[], size, height, clear)
+ *       Each node holds up to B sorted values, so the tree is only about
+ *       log_B(n) levels deep and a lookup reads one cache line per level for
+ *       the values (leaves, most of the nodes, have nothing else). The
+ *       search inside a node compares the value with all of them at once
+ *       using SIMD instructions for arithmetic T.
+ *       Like the BST, it does not accept duplicates.
+ * @tparam T Type of data
+ * @tparam B Maximum number of values per node (at least 3)
+ */
+template <typename T, unsigned B = btreeDefaultOrder<T>()>
+class BTree {
+    static_assert(B >= 3, "a B-tree node needs room for at least 3 values");
+    static_assert(B <= 65535, "the value count of a node is an unsigned short");
+
+  public:
+    /**
+     * @struct BTreeNode
+     * @brief A node of the B-tree, a leaf unless it is a BTreeInternal
+     *        The values come first, so a node search can load whole vectors
+     *        from the start of the cache line
+     */
+    struct alignas(BTREE_CACHE_LINE) BTreeNode {
+        T keys[B]; // sorted values, the first count are in use
+        unsigned short count; // number of values in the node
+        bool leaf; // whether the node has no children
+
+        BTreeNode(bool isLeaf) : keys(), count(0), leaf(isLeaf) {}
+    };
+
+    /**
+     * @struct BTreeInternal
+     * @brief An internal node: children[i] holds the values between
+     *        keys[i - 1] and keys[i]
+     */
+    struct BTreeInternal : BTreeNode {
+        unsigned size; // number of values in the subtree rooted here (kept up to date)
+        BTreeNode* children[B + 1];
+
+        BTreeInternal() : BTreeNode(false), size(0), children() {}
+    };
+
+    // nodes per page of the pools when no expected size is given
+    static const unsigned DEFAULT_NODES_PER_PAGE = 64;
+
+    /**
+     * @brief Default constructor
+     *        The tree creates two pools of cache-line aligned blocks, one for
+     *        the leaves and one for the bigger internal nodes, which it shares
+     *        with its copies and which go with the last of them
+     * @param expectedSize Expected number of values, to size the pages of the
+     *                     pools (0 for the default)
+     */
+    BTree(unsigned expectedSize = 0);
+
+    /**
+     * @brief Copy constructor
+     * @param rhs The BTree to be copied
+     */
+    BTree(const BTree& rhs);
+
+    /**
+     * @brief Move constructor
+     *        O(1), it takes over rhs's nodes and pools; rhs is left empty
+     * @param rhs The BTree to be moved from
+     */
+    BTree(BTree&& rhs) noexcept;
+
+    /**
+     * @brief Assignment operator
+     * @param rhs The BTree to be copied
+     */
+    BTree& operator=(const BTree& rhs);
+
+    /**
+     * @brief Move assignment operator
+     * @param rhs The BTree to be moved from
+     */
+    BTree& operator=(BTree&& rhs) noexcept;
+
+    /**
+     * @brief Destructor
+     *        It calls clear() to free all nodes
+     */
+    ~BTree();
+
+    /**
+     * @brief Subscript operator that returns the value at the specified
+     *        index in order, in O(log n) from the cached subtree sizes
+     *        (B-tree values live in arrays, not nodes of their own, so this
+     *        returns the value rather than the BST's node)
+     * @param index The index of the value to be returned
+     * @return The value at the specified index
+     * @throw BSTException if the index is out of range
+     */
+    const T& operator[](int index) const;
+
+    /**
+     * @brief Insert a value into the tree
+     *        Full nodes are split on the way down, so the walk never has to
+     *        come back up
+     * @param value The value to be added
+     * @throw BSTException if the value already exists
+     */
+    void add(const T& value);
+
+    /**
+     * @brief Remove a value from the tree
+     *        Nodes about to be walked into are refilled (from a sibling, or
+     *        by merging with it) on the way down, so none can underflow
+     * @param value The value to be removed
+     * @throw BSTException if the value does not exist
+     */
+    void remove(const T& value);
+
+    /**
+     * @brief Remove all values in the tree
+     */
+    void clear();
+
+    /**
+     * @brief Find a value in the tree
+     * @param value The value to be found
+     * @param compares The number of nodes searched (a reference to provide
+     *                 as output), each of them by one SIMD comparison for
+     *                 arithmetic T, in place of one compare per BST node
+     * @return true if the value is found
+     *         false otherwise
+     */
+    bool find(const T& value, unsigned& compares) const;
+
+    /**
+     * @brief Check if the tree is empty
+     * @return true if the tree is empty
+     */
+    bool empty() const;
+
+    /**
+     * @brief Get the number of values in the tree
+     * @return The number of values in the tree
+     */
+    unsigned int size() const;
+
+    /**
+     * @brief Get the height of the tree in nodes below the root, all the
+     *        leaves being at the same depth
+     * @return The height of the tree (-1 if empty)
+     */
+    int height() const;
+
+  private:
+
+    // the fewest values a node other than the root may have
+    static const unsigned MIN_KEYS = (B - 1) / 2;
+
+    // the root of the tree
+    BTreeNode* root_;
+
+    // the number of values in the tree
+    unsigned size_;
+
+    // the height of the tree, -1 if empty
+    int height_;
+
+    // the pools of leaves and of internal nodes
+    std::shared_ptr<SimpleAllocator> leafAllocator_;
+    std::shared_ptr<SimpleAllocator> internalAllocator_;
+
+    // scratch list of the internal nodes an add/remove walks through,
+    // whose sizes change once it succeeds
+    std::vector<BTreeInternal*> path_;
+
+    /**
+     * @brief Count the values of a node less than the given one
+     *        With SIMD compares for arithmetic T, a binary search otherwise
+     * @param node The node to search
+     * @param value The value to compare with
+     * @return The index of the first value not less than value
+     */
+    static unsigned rank_(const BTreeNode* node, const T& value);
+
+    /**
+     * @brief Get the number of values in a subtree
+     * @param node The subtree's root
+     * @return Its cached size (its count for a leaf)
+     */
+    static unsigned subtreeSize_(const BTreeNode* node);
+
+    /**
+     * @brief Access a node as an internal node
+     * @param node The node, which must not be a leaf
+     */
+    static BTreeInternal* internal_(BTreeNode* node);
+
+    /**
+     * @brief Allocate a new node from its pool and construct it in place
+     * @param leaf Whether to make a leaf or an internal node
+     * @throw BSTException if the pool is out of memory
+     */
+    BTreeNode* makeNode_(bool leaf);
+
+    /**
+     * @brief Destroy a node and return its block to its pool
+     * @param node The node to be freed
+     */
+    void freeNode_(BTreeNode* node);
+
+    /**
+     * @brief Split the full child i of a node around its middle value,
+     *        which moves up into the node
+     * @param parent The node, which is not full
+     * @param i The index of the child
+     */
+    void splitChild_(BTreeInternal* parent, unsigned i);
+
+    /**
+     * @brief Make sure child i of a node has more than MIN_KEYS values,
+     *        by borrowing one from a sibling or merging with one
+     * @param parent The node
+     * @param i The index of the child
+     * @return The index of the child now holding child i's values
+     */
+    unsigned fillChild_(BTreeInternal* parent, unsigned i);
+
+    /**
+     * @brief Merge child i + 1 of a node and the value between them into child i
+     * @param parent The node
+     * @param i The index of the left child
+     */
+    void mergeChildren_(BTreeInternal* parent, unsigned i);
+
+    /**
+     * @brief Free every node of a subtree
+     * @param node The subtree's root (may be nullptr)
+     */
+    void clear_(BTreeNode* node);
+
+    /**
+     * @brief Copy a subtree (the recursion only goes height deep)
+     * @param node The subtree to copy
+     * @return The root of the copy
+     */
+    BTreeNode* copy_(const BTreeNode* node);
+};
+
+#include "BTree.cpp"
+
+#endif
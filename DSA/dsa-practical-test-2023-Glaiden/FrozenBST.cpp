@@ -0,0 +1,194 @@
+#include "FrozenBST.h"
+#include <algorithm>
+#include <climits>
+
+// Construct an empty tree
+template <typename T>
+FrozenBST<T>::FrozenBST() : size_(0), levels_(0), layout_(EYTZINGER) {}
+
+// Construct the tree from a range of sorted values
+template <typename T>
+template <typename InputIt>
+FrozenBST<T>::FrozenBST(InputIt first, InputIt last, Layout layout) : size_(0), levels_(0), layout_(layout) {
+    std::vector<T> sorted(first, last);
+    size_ = sorted.size();
+    if (size_ == 0) {
+        return;
+    }
+    levels_ = depthOf_(size_);
+
+    // walk the complete tree in order, index k has the children 2k and 2k+1
+    // (index 0 is unused and just holds a copy of a value)
+    data_.assign(size_ + 1, sorted[0]);
+    size_t k = 1;
+    while (2 * k <= size_) {
+        k *= 2;
+    }
+    for (size_t i = 0; i < size_; ++i) {
+        data_[k] = sorted[i];
+        if (2 * k + 1 <= size_) {
+            // the next value is the leftmost one of the right subtree
+            k = 2 * k + 1;
+            while (2 * k <= size_) {
+                k *= 2;
+            }
+        } else {
+            // otherwise climb until we come up from a left child
+            while (k & 1) {
+                k >>= 1;
+            }
+            k >>= 1;
+        }
+    }
+    if (layout_ == EYTZINGER) {
+        return;
+    }
+
+    // move every node to its van Emde Boas position, the positions of the
+    // missing nodes of the last level are left as padding
+    topDepth_.assign(levels_ + 1, 0);
+    topSize_.assign(levels_ + 1, 0);
+    bottomSize_.assign(levels_ + 1, 0);
+    splitVanEmdeBoas_(1, levels_);
+    std::vector<T> nodes((size_t(1) << levels_) - 1, sorted[0]);
+    size_t positions[sizeof(size_t) * CHAR_BIT + 1];
+    for (size_t index = 1; index <= size_; ++index) {
+        nodes[positionVanEmdeBoas_(index, depthOf_(index), positions)] = data_[index];
+    }
+    data_.swap(nodes);
+}
+
+// Find a value in the tree
+template <typename T>
+bool FrozenBST<T>::find(const T& value, unsigned& compares) const {
+    if (size_ == 0) {
+        return false;
+    }
+    return layout_ == EYTZINGER ? findEytzinger_(value, compares) : findVanEmdeBoas_(value, compares);
+}
+
+// Find the lower bound of a value in the Eytzinger layout
+// - the loop always runs to the bottom, the comparison only picks the child
+template <typename T>
+bool FrozenBST<T>::findEytzinger_(const T& value, unsigned& compares) const {
+    const T* base = data_.data();
+    size_t index = 1;
+    unsigned steps = 0;
+    while (index <= size_) {
+#if defined(__GNUC__)
+        __builtin_prefetch(base + std::min(index << PREFETCH_LEVELS, size_));
+#endif
+        index = 2 * index + (base[index] < value);
+        ++steps;
+    }
+    index = lowerBound_(index);
+    bool found = index != 0 && !(value < base[index]);
+
+    // a pointer-based search would have stopped at the value
+    compares += found ? depthOf_(index) : steps;
+    return found;
+}
+
+// Find the lower bound of a value in the van Emde Boas layout
+// - the same walk as Eytzinger, with each position looked up by depth
+template <typename T>
+bool FrozenBST<T>::findVanEmdeBoas_(const T& value, unsigned& compares) const {
+    size_t positions[sizeof(size_t) * CHAR_BIT + 1];
+    positions[0] = 0;
+    size_t index = 1;
+    unsigned depth = 1;
+    while (index <= size_) {
+        // the root's tables are zero, so it is at position 0
+        size_t position = positions[topDepth_[depth]] + topSize_[depth] + (index & topSize_[depth]) * bottomSize_[depth];
+        positions[depth] = position;
+        index = 2 * index + (data_[position] < value);
+        ++depth;
+    }
+    index = lowerBound_(index);
+    bool found = index != 0 && !(value < data_[positions[depthOf_(index)]]);
+    compares += found ? depthOf_(index) : depth - 1;
+    return found;
+}
+
+// Set up the depth tables of the van Emde Boas layout
+template <typename T>
+void FrozenBST<T>::splitVanEmdeBoas_(unsigned rootDepth, unsigned height) {
+    if (height <= 1) {
+        return;
+    }
+    unsigned top = height / 2;
+    unsigned bottom = height - top;
+    unsigned depth = rootDepth + top; // the roots of the bottom trees
+    topDepth_[depth] = rootDepth;
+    topSize_[depth] = (size_t(1) << top) - 1;
+    bottomSize_[depth] = (size_t(1) << bottom) - 1;
+    splitVanEmdeBoas_(rootDepth, top);
+    splitVanEmdeBoas_(depth, bottom);
+}
+
+// Get the array position of a node in the van Emde Boas layout
+// - a subtree is laid out as its top tree followed by its bottom trees in
+//   order, and the low bits of the index pick the bottom tree
+template <typename T>
+size_t FrozenBST<T>::positionVanEmdeBoas_(size_t index, unsigned depth, size_t* positions) const {
+    positions[0] = positions[1] = 0;
+    for (unsigned d = 2; d <= depth; ++d) {
+        size_t ancestor = index >> (depth - d);
+        positions[d] = positions[topDepth_[d]] + topSize_[d] + (ancestor & topSize_[d]) * bottomSize_[d];
+    }
+    return positions[depth];
+}
+
+// Get the depth of a node from its breadth-first index
+template <typename T>
+unsigned FrozenBST<T>::depthOf_(size_t index) {
+#if defined(__GNUC__)
+    return sizeof(unsigned long long) * CHAR_BIT - __builtin_clzll(index);
+#else
+    unsigned depth = 0;
+    for (; index != 0; index >>= 1) {
+        ++depth;
+    }
+    return depth;
+#endif
+}
+
+// Get the lower bound from the index a search fell off the tree at
+template <typename T>
+size_t FrozenBST<T>::lowerBound_(size_t index) {
+#if defined(__GNUC__)
+    return index >> (__builtin_ctzll(~(unsigned long long)index) + 1);
+#else
+    while (index & 1) {
+        index >>= 1;
+    }
+    return index >> 1;
+#endif
+}
+
+// Get the number of values in the tree
+template <typename T>
+unsigned FrozenBST<T>::size() const {
+    return size_;
+}
+
+// Check if the tree is empty
+template <typename T>
+bool FrozenBST<T>::empty() const {
+    return size_ == 0;
+}
+
+// Get the height of the tree
+template <typename T>
+int FrozenBST<T>::height() const {
+    return int(levels_) - 1;
+}
+
+// Get the layout of the tree
+template <typename T>
+typename FrozenBST<T>::Layout FrozenBST<T>::layout() const {
+    return layout_;
+}
+
+// Explicit instantiation for the types you plan to use
+template class FrozenBST<int>;
@@ -0,0 +1,168 @@
+/**
+ * @file FrozenBST.h
+ * @brief FrozenBST class definition
+ *        An immutable, read-optimized copy of a BST/AVL (see BST::freeze)
+ * @date 19 Oct 2026
+ */
+#ifndef FROZENBST_H
+#define FROZENBST_H
+#include <cstddef>
+#include <vector>
+
+/**
+ * @class FrozenBST
+ * @brief Immutable search tree stored in a flat array
+ *       The values are laid out as the complete binary tree of their sorted
+ *       order (every level full but the last, which fills from the left),
+ *       so there are no pointers to chase: the children of a node are found
+ *       by index arithmetic and a lookup walks down without branching on
+ *       the comparisons.
+ *       Two layouts of that same tree are offered:
+ *       - EYTZINGER: breadth-first order, the children of node i are 2i and
+ *         2i+1. Nodes four levels down are prefetched while the search is
+ *         still above them, so their cache misses overlap.
+ *       - VAN_EMDE_BOAS: recursive blocks of subtrees of half the height, so
+ *         that every cache line and page holds a small subtree. A lookup
+ *         touches fewer lines and pages without any tuning, but computing
+ *         the positions costs more than the prefetched Eytzinger walk (see
+ *         bench), and the array is padded up to the next perfect tree (at
+ *         most twice the size).
+ * @tparam T Type of data (ordered by operator<)
+ */
+template <typename T>
+class FrozenBST {
+  public:
+    enum Layout { EYTZINGER, VAN_EMDE_BOAS };
+
+    /**
+     * @brief Construct an empty tree
+     */
+    FrozenBST();
+
+    /**
+     * @brief Construct the tree from a range of sorted values in O(n)
+     *        (O(n log n) for the van Emde Boas layout)
+     * @param first Start of the range
+     * @param last End of the range
+     * @param layout How to lay out the tree in memory
+     */
+    template <typename InputIt>
+    FrozenBST(InputIt first, InputIt last, Layout layout = EYTZINGER);
+
+    /**
+     * @brief Find a value in the tree
+     * @param value The value to be found
+     * @param compares The number of comparisons made (a reference to
+     *                 provide as output), counted like BST::find does: one
+     *                 for every node on the path down to the value, or
+     *                 down to the bottom of the tree if it is not there
+     *                 (the same in both layouts)
+     * @return true if the value is found
+     *         false otherwise
+     */
+    bool find(const T& value, unsigned& compares) const;
+
+    /**
+     * @brief Get the number of values in the tree
+     * @return The number of values in the tree
+     */
+    unsigned size() const;
+
+    /**
+     * @brief Check if the tree is empty
+     * @return true if the tree is empty
+     */
+    bool empty() const;
+
+    /**
+     * @brief Get the height of the tree, which is floor(log2(size))
+     * @return The height of the tree (-1 if empty)
+     */
+    int height() const;
+
+    /**
+     * @brief Get the layout of the tree
+     * @return The layout chosen on construction
+     */
+    Layout layout() const;
+
+  private:
+
+    // nodes four levels down share a cache line for 4-byte values, so
+    // that is how far ahead the Eytzinger search prefetches
+    static const size_t PREFETCH_LEVELS = 4;
+
+    /**
+     * @brief Find the lower bound of a value in the Eytzinger layout
+     * @param value The value to be found
+     * @param compares The number of comparisons made
+     * @return true if the value is found
+     */
+    bool findEytzinger_(const T& value, unsigned& compares) const;
+
+    /**
+     * @brief Find the lower bound of a value in the van Emde Boas layout
+     * @param value The value to be found
+     * @param compares The number of comparisons made
+     * @return true if the value is found
+     */
+    bool findVanEmdeBoas_(const T& value, unsigned& compares) const;
+
+    /**
+     * @brief Set up the depth tables of the van Emde Boas layout
+     *        The subtree of height h rooted at depth d is split into a top
+     *        tree of height h/2 and the bottom trees below it, recursively
+     * @param rootDepth The depth of the subtree's root (the root is 1)
+     * @param height The height of the subtree in levels
+     */
+    void splitVanEmdeBoas_(unsigned rootDepth, unsigned height);
+
+    /**
+     * @brief Get the array position of the node with a breadth-first index
+     *        in the van Emde Boas layout
+     * @param index The breadth-first index (the root is 1)
+     * @param depth The depth of the node (the root is 1)
+     * @param positions The positions of its ancestors, filled in on return
+     * @return The position of the node
+     */
+    size_t positionVanEmdeBoas_(size_t index, unsigned depth, size_t* positions) const;
+
+    /**
+     * @brief Get the depth of a node from its breadth-first index
+     * @param index The breadth-first index (the root is 1)
+     * @return The depth of the node (the root is 1)
+     */
+    static unsigned depthOf_(size_t index);
+
+    /**
+     * @brief Get the lower bound from the index a search fell off the tree at
+     *        The turns right at the bottom passed smaller values, so the
+     *        lower bound is where the search last turned left (0 if never)
+     * @param index The index past the bottom of the tree
+     * @return The breadth-first index of the lower bound
+     */
+    static size_t lowerBound_(size_t index);
+
+    // the values, in breadth-first order from index 1 (EYTZINGER) or by
+    // the van Emde Boas positions from index 0 (VAN_EMDE_BOAS)
+    std::vector<T> data_;
+
+    // the number of values
+    size_t size_;
+
+    // the number of levels, 0 if empty
+    unsigned levels_;
+
+    Layout layout_;
+
+    // van Emde Boas tables by depth d > 1: the node at depth d is in the
+    // bottom tree (of bottomSize_[d] nodes) of a top tree of topSize_[d]
+    // nodes rooted at depth topDepth_[d]
+    std::vector<unsigned> topDepth_;
+    std::vector<size_t> topSize_;
+    std::vector<size_t> bottomSize_;
+};
+
+#include "FrozenBST.cpp"
+
+#endif
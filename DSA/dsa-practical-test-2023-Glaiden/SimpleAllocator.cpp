@@ -6,52 +6,207 @@
 
 // #define DEBUG
 #include "SimpleAllocator.h"
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <mutex>
+#include <new>
 #include <iostream>
 
+// pages of every allocator with useHandles, numbered from 1; a released
+// number is chained through its stride until it is taken again
+SimpleAllocator::HandlePage SimpleAllocator::handlePages_[MAX_HANDLE_PAGES + 1];
+static unsigned nextHandlePage = 1; // next number never handed out
+static unsigned releasedHandlePage = 0; // last released number (0 if none)
+static std::mutex handlePageLock; // over the three above, as pools may live on any thread
+
 SimpleAllocator::SimpleAllocator(size_t objectSize,
                                  const SimpleAllocatorConfig& config)
-    : config_(config), stats_{}{
+    : config_(config), stats_{}, pPageList_(nullptr), pFreeList_(nullptr) {
+    // each block must be able to hold the free list link, and stay pointer aligned
+    blockSize_ = (std::max(objectSize, sizeof(Node)) + sizeof(Node) - 1) / sizeof(Node) * sizeof(Node);
     stats_.objectSize = objectSize;
-    config_.useCPPMemManager = true; // always true for this dummy allocator
+    stats_.pageSize = sizeof(Node) + config_.objectsPerPage * blockSize_;
+    if (config_.alignmentBoundary > 1) {
+        // every block starts on the boundary, the page has room to align the first one
+        size_t boundary = config_.alignmentBoundary;
+        blockSize_ = (blockSize_ + boundary - 1) / boundary * boundary;
+        stats_.pageSize = sizeof(Node) + (boundary - 1) + config_.objectsPerPage * blockSize_;
+    }
+    if (config_.useHandles && config_.useCPPMemManager) {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "SimpleAllocator: Handles need the blocks to be on pages.");
+    }
+    if (config_.useHandles && config_.objectsPerPage > (1u << HANDLE_SLOT_BITS)) {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "SimpleAllocator: Too many objects per page for a handle's slot.");
+    }
 }
 
 SimpleAllocator::~SimpleAllocator() {
+    if (!pageHandles_.empty()) {
+        std::lock_guard<std::mutex> guard(handlePageLock);
+        for (const auto& page : pageHandles_) {
+            unsigned number = page.second >> HANDLE_SLOT_BITS;
+            handlePages_[number].pBlocks = nullptr;
+            handlePages_[number].stride = releasedHandlePage;
+            releasedHandlePage = number;
+        }
+    }
+    while (pPageList_ != nullptr) {
+        Node* pNext = pPageList_->pNext;
+        delete[] reinterpret_cast<char*>(pPageList_);
+        pPageList_ = pNext;
+    }
 }
 
 void* SimpleAllocator::allocate(const char* pLabel) {
+    (void)pLabel; // labels are only kept with EXTERNAL_HEADER, which is not supported here
+
     // use cpp mem manager if enabled
     if (config_.useCPPMemManager) {
-        // update stats assuming allocation succeeds
+        char* pObject = nullptr;
+        try {
+            // return exact number of bytes requested using char
+            if (config_.alignmentBoundary > 1) {
+                pObject = static_cast<char*>(::operator new(stats_.objectSize, std::align_val_t(config_.alignmentBoundary)));
+            } else {
+                pObject = new char[stats_.objectSize];
+            }
+        } catch (const std::bad_alloc&) {
+            throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "allocate: No system memory available.");
+        }
         ++stats_.allocations;
-        ++stats_.mostObjects;
+        ++stats_.objectsInUse;
+        stats_.mostObjects = std::max(stats_.mostObjects, stats_.objectsInUse);
+        return pObject;
+    }
 
-        // return exact number of bytes requested using char
-        return new char[stats_.objectSize];
+    // take the first free block, making a new page if there is none
+    if (pFreeList_ == nullptr) {
+        allocateNewPage();
     }
-    else {
-        // this is supposed to be the custom allocation code but this is a dummy
-        // - this should never be called in this dummy allocator
-        return nullptr;
+    Node* pBlock = pFreeList_;
+    pFreeList_ = pFreeList_->pNext;
+    if (config_.isDebug) {
+        std::memset(pBlock, ALLOCATED_PATTERN, stats_.objectSize);
     }
+
+    ++stats_.allocations;
+    --stats_.freeObjects;
+    ++stats_.objectsInUse;
+    stats_.mostObjects = std::max(stats_.mostObjects, stats_.objectsInUse);
+    return pBlock;
 }
 
 void SimpleAllocator::free(void* pObject) {
-    if (config_.useCPPMemManager) {
-        // update stats assuming allocation successful
-        ++stats_.deallocations;
-        --stats_.allocations;
+    if (pObject == nullptr) {
+        return;
+    }
 
+    if (config_.useCPPMemManager) {
         // delete exact number of bytes represented using char
-        //::operator delete(static_cast<char*>(p_object), stats_.ObjectSize_);
-        delete[] static_cast<char*>(pObject);
-
-        pObject = nullptr;
-    } 
+        if (config_.alignmentBoundary > 1) {
+            ::operator delete(pObject, std::align_val_t(config_.alignmentBoundary));
+        } else {
+            delete[] static_cast<char*>(pObject);
+        }
+    }
     else {
-        // again this should never be called in this dummy allocator
+        // push the block back on the free list
+        // - the patterns are only written in debug mode, they cost a pass over the object
+        if (config_.isDebug) {
+            std::memset(pObject, FREED_PATTERN, blockSize_);
+        }
+        Node* pBlock = static_cast<Node*>(pObject);
+        pBlock->pNext = pFreeList_;
+        pFreeList_ = pBlock;
+        ++stats_.freeObjects;
+    }
+    ++stats_.deallocations;
+    --stats_.objectsInUse;
+}
+
+void SimpleAllocator::allocateNewPage() {
+    if (stats_.pagesInUse >= config_.maxPages) {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_PAGE, "allocateNewPage: The maximum number of pages has been allocated.");
+    }
+    char* pPage = nullptr;
+    try {
+        pPage = new char[stats_.pageSize];
+    } catch (const std::bad_alloc&) {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "allocateNewPage: No system memory available.");
+    }
+    if (config_.isDebug) {
+        std::memset(pPage + sizeof(Node), UNALLOCATED_PATTERN, stats_.pageSize - sizeof(Node));
+    }
+
+    // the blocks start after the page link, on the alignment boundary if there is one
+    char* pBlocks = pPage + sizeof(Node);
+    if (config_.alignmentBoundary > 1) {
+        size_t misalignment = reinterpret_cast<std::uintptr_t>(pBlocks) % config_.alignmentBoundary;
+        pBlocks += misalignment ? config_.alignmentBoundary - misalignment : 0;
+    }
+
+    // number the page for handles, reusing a number released by another pool
+    if (config_.useHandles) {
+        std::lock_guard<std::mutex> guard(handlePageLock);
+        unsigned number = releasedHandlePage;
+        if (number != 0) {
+            releasedHandlePage = static_cast<unsigned>(handlePages_[number].stride);
+        } else if (nextHandlePage <= MAX_HANDLE_PAGES) {
+            number = nextHandlePage++;
+        } else {
+            delete[] pPage;
+            throw SimpleAllocatorException(SimpleAllocatorException::E_NO_PAGE, "allocateNewPage: No page number left for handles.");
+        }
+        handlePages_[number].pBlocks = pBlocks;
+        handlePages_[number].stride = blockSize_;
+        pageHandles_[pBlocks] = static_cast<Handle>(number) << HANDLE_SLOT_BITS;
+    }
+
+    // link the page in front of the page list
+    Node* pPageNode = reinterpret_cast<Node*>(pPage);
+    pPageNode->pNext = pPageList_;
+    pPageList_ = pPageNode;
+
+    // push the blocks backwards so that the first block is handed out first
+    for (unsigned i = config_.objectsPerPage; i > 0; --i) {
+        Node* pBlock = reinterpret_cast<Node*>(pBlocks + (i - 1) * blockSize_);
+        pBlock->pNext = pFreeList_;
+        pFreeList_ = pBlock;
+    }
+    stats_.freeObjects += config_.objectsPerPage;
+    ++stats_.pagesInUse;
+}
+
+SimpleAllocator::Handle SimpleAllocator::allocateHandle() {
+    if (!config_.useHandles) {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "allocateHandle: The allocator does not use handles.");
+    }
+    return handleOf(allocate());
+}
+
+void SimpleAllocator::freeHandle(Handle handle) {
+    free(resolve(handle));
+}
+
+SimpleAllocator::Handle SimpleAllocator::handleOf(const void* pObj) const {
+    if (pObj == nullptr) {
+        return NULL_HANDLE;
+    }
+
+    // the page is the last one whose blocks start at or before the object
+    const char* pBlock = static_cast<const char*>(pObj);
+    auto page = pageHandles_.upper_bound(pBlock);
+    if (page == pageHandles_.begin()) {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "handleOf: The block is not on a page.");
+    }
+    --page;
+    size_t offset = static_cast<size_t>(pBlock - page->first);
+    if (offset % blockSize_ != 0 || offset / blockSize_ >= config_.objectsPerPage) {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "handleOf: The block is not on a block boundary in a page.");
     }
+    return page->second | static_cast<Handle>(offset / blockSize_);
 }
 
 SimpleAllocatorConfig SimpleAllocator::getConfig() const { return config_; }
@@ -12,6 +12,8 @@
 #define SIMPLEALLOCATOR_H
 #include <string>
 #include <iostream>
+#include <cstdint>
+#include <map>
 
 // Defaults for SimpleAllocator construction when client does not specify
 static const int DEFAULT_OBJECTS_PER_PAGE = 4;
@@ -145,7 +147,8 @@ struct SimpleAllocatorConfig {
         leftAlignBytesSize(0),
         interAlignBytesSize(0),
         padBytesSize(_padBytesSize), 
-        isDebug(_isDebug){}
+        isDebug(_isDebug),
+        useHandles(false){}
 
     bool useCPPMemManager; // Use C++ memory manager (operator new) instead of malloc
     unsigned objectsPerPage; // Number of objects per page
@@ -156,6 +159,7 @@ struct SimpleAllocatorConfig {
     unsigned interAlignBytesSize; // num bytes in inter alignment (computed from alignmentBoundary)
     unsigned padBytesSize; // num bytes in padding
     bool isDebug; // True if debug mode is on
+    bool useHandles; // Number the blocks so they can be referred to by 32-bit handles
 };
 
 /**
@@ -212,6 +216,12 @@ struct Node {
 
 /**
  * The SimpleAllocator class
+ * - with useCPPMemManager every object comes from operator new
+ * - otherwise objects are carved from pages of objectsPerPage blocks and
+ *   recycled through a free list; this trimmed-down version ignores the
+ *   header and pad settings of the config
+ * - an alignmentBoundary (a power of two) starts every block on it
+ * - with useHandles, objects can also be referred to by 32-bit handles
  */
 class SimpleAllocator {
 public:
@@ -240,6 +250,7 @@ public:
      * Allocate memory
      * @param label label for memory block (only for EXTERNAL_HEADER)
      * @return pointer to allocated memory
+     * @throws SimpleAllocatorException if maxPages is reached or operator new fails
      */
     void* allocate(const char* pLabel = 0);
 
@@ -249,6 +260,51 @@ public:
      */
     void free(void* pObj);
 
+    /**
+     * A compact reference to an object of an allocator with useHandles
+     * - the low HANDLE_SLOT_BITS are the block's slot in its page, the bits
+     *   above number the page in a table shared by all such allocators, so
+     *   resolve() needs no allocator at hand and is as cheap as a lookup
+     * - 0 is never a valid handle (page numbers start at 1)
+     */
+    typedef uint32_t Handle;
+    static const Handle NULL_HANDLE = 0;
+    static const unsigned HANDLE_SLOT_BITS = 16; // so a page holds at most 65536 objects
+    static const unsigned MAX_HANDLE_PAGES = (1u << (32 - HANDLE_SLOT_BITS)) - 1; // pages of all allocators together
+
+    /**
+     * Allocate memory and refer to it by handle
+     * @return handle of the allocated memory
+     * @throws SimpleAllocatorException if the allocator does not use handles,
+     *         or as allocate() does
+     */
+    Handle allocateHandle();
+
+    /**
+     * Free (deallocate) memory referred to by handle
+     * @param handle handle of the object to deallocate
+     */
+    void freeHandle(Handle handle);
+
+    /**
+     * Get the object a handle refers to
+     * @param handle handle of an object of any allocator (NULL_HANDLE gives nullptr)
+     * @return pointer to the object
+     */
+    static void* resolve(Handle handle) {
+        // page 0 stays all zeros, so NULL_HANDLE needs no branch
+        const HandlePage& page = handlePages_[handle >> HANDLE_SLOT_BITS];
+        return page.pBlocks + (handle & ((1u << HANDLE_SLOT_BITS) - 1)) * page.stride;
+    }
+
+    /**
+     * Get the handle of an object allocated from this allocator
+     * @param pObj pointer to the object (nullptr gives NULL_HANDLE)
+     * @return handle of the object
+     * @throws SimpleAllocatorException if pObj is not a block of this allocator's pages
+     */
+    Handle handleOf(const void* pObj) const;
+
     /**
      * Get the configuration parameters struct
      * @return configuration parameters
@@ -270,6 +326,25 @@ private:
     // - feel free to add your own private stuff
     SimpleAllocatorConfig config_; // Configuration parameters
     SimpleAllocatorStats stats_; // Configuration parameters
+    size_t blockSize_; // Object size rounded up to hold a Node and keep pointers (and the boundary) aligned
+    Node* pPageList_; // Pages allocated so far, linked through their first bytes
+    Node* pFreeList_; // Free blocks on all pages
+
+    /**
+     * Where the blocks of a page numbered for handles are
+     */
+    struct HandlePage {
+        char* pBlocks; // first block of the page
+        size_t stride; // bytes from one block to the next
+    };
+    static HandlePage handlePages_[MAX_HANDLE_PAGES + 1]; // by page number, of all allocators
+    std::map<const char*, Handle> pageHandles_; // handle of the first block by page (useHandles)
+
+    /**
+     * Allocate a new page and put its blocks on the free list
+     * @throws SimpleAllocatorException if maxPages is reached or operator new fails
+     */
+    void allocateNewPage();
 };
 
 #endif // SIMPLEALLOCATOR_H
@@ -0,0 +1,233 @@
+/**
+ * @file bench.cpp
+ * @brief Benchmarks for the AVL tree
+ *        - inserts n shuffled keys for n = 10^3 .. <max> and prints the time
+ *          per n*log2(n), which stays roughly flat when inserts are O(log n)
+ *        - node churn with the tree's own SimpleAllocator pool against
+ *          an allocator that goes to the heap for every node
+ *        - join-based set operations against adding one value at a time
+ *        - lookups in the AVL tree against its frozen copies
+ *        - the B-tree and the AVL tree with handle links against the AVL
+ *          tree on the same adds, finds and removes
+ *        Usage: ./bench [max-keys] (default 10000000)
+ * @date 19 Oct 2026
+ */
+
+#include "AVL.h"
+#include "BTree.h"
+#include "SimpleAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Generate n shuffled consecutive keys
+ * @param n number of keys
+ * @return the keys
+ */
+std::vector<int> shuffledKeys(unsigned n) {
+    std::vector<int> keys(n);
+    for (unsigned i = 0; i < n; ++i)
+        keys[i] = i;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(n));
+    return keys;
+}
+
+/**
+ * @brief Time n shuffled inserts for n = 10^3 .. maxKeys
+ * @param maxKeys largest number of keys
+ */
+void insertScaling(unsigned maxKeys) {
+    std::cout << std::setw(10) << "keys" << std::setw(12) << "seconds"
+              << std::setw(16) << "ns/(n log2 n)" << std::setw(8) << "height" << std::endl;
+    for (unsigned n = 1000; n <= maxKeys; n *= 10) {
+        // shuffled consecutive keys, generated outside the timed region
+        std::vector<int> keys = shuffledKeys(n);
+
+        AVL<int> avl;
+        auto start = std::chrono::steady_clock::now();
+        for (int key : keys)
+            avl.add(key);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double perOp = elapsed.count() * 1e9 / (n * std::log2(n));
+        std::cout << std::setw(10) << n << std::setw(12) << std::fixed << std::setprecision(3)
+                  << elapsed.count() << std::setw(16) << std::setprecision(2) << perOp
+                  << std::setw(8) << avl.height() << std::endl;
+    }
+}
+
+/**
+ * @brief Time node churn (add all, remove half, add them back, clear)
+ *        with the tree's own pool and with a heap-backed allocator
+ * @param n number of keys
+ */
+void churn(unsigned n) {
+    std::vector<int> keys = shuffledKeys(n);
+    SimpleAllocator heap(sizeof(AVL<int>::BinTreeNode), SimpleAllocatorConfig(true));
+
+    std::cout << std::setw(10) << "allocator" << std::setw(10) << "add" << std::setw(10) << "remove"
+              << std::setw(10) << "re-add" << std::setw(10) << "clear" << "  (ms, " << n << " keys)" << std::endl;
+    for (int useHeap = 0; useHeap < 2; ++useHeap) {
+        AVL<int> avl(useHeap ? &heap : nullptr, n);
+        double ms[4];
+        auto start = std::chrono::steady_clock::now();
+        auto lap = [&](int i) {
+            auto now = std::chrono::steady_clock::now();
+            ms[i] = std::chrono::duration<double, std::milli>(now - start).count();
+            start = now;
+        };
+        for (int key : keys)
+            avl.add(key);
+        lap(0);
+        for (unsigned i = 0; i < n; i += 2)
+            avl.remove(keys[i]);
+        lap(1);
+        for (unsigned i = 0; i < n; i += 2)
+            avl.add(keys[i]);
+        lap(2);
+        avl.clear();
+        lap(3);
+
+        std::cout << std::setw(10) << (useHeap ? "heap" : "pool") << std::fixed << std::setprecision(1);
+        for (double t : ms)
+            std::cout << std::setw(10) << t;
+        std::cout << std::endl;
+    }
+}
+
+/**
+ * @brief Time merging two trees of n values each (the even and the odd
+ *        values of 0 .. 2n-1) with the set operations and with add
+ * @param n number of values in each tree
+ */
+void setOperations(unsigned n) {
+    std::vector<int> evens, odds;
+    for (unsigned i = 0; i < n; ++i) {
+        evens.push_back(2 * i);
+        odds.push_back(2 * i + 1);
+    }
+    auto ms = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::cout << std::fixed << std::setprecision(1) << "merging 2 x " << n << " values (ms):" << std::endl;
+
+    // copies share the pool, so unionWith can move the nodes instead of copying them
+    AVL<int> avl;
+    AVL<int> other(avl);
+    avl.buildFromSorted(evens.begin(), evens.end());
+    auto start = std::chrono::steady_clock::now();
+    for (int value : odds)
+        avl.add(value);
+    std::cout << std::setw(16) << "add loop" << std::setw(10) << ms(start) << std::endl;
+
+    avl.buildFromSorted(evens.begin(), evens.end());
+    other.buildFromSorted(odds.begin(), odds.end());
+    start = std::chrono::steady_clock::now();
+    avl.unionWith(other);
+    std::cout << std::setw(16) << "unionWith" << std::setw(10) << ms(start) << std::endl;
+
+    other.buildFromSorted(odds.begin(), odds.end());
+    start = std::chrono::steady_clock::now();
+    avl.differenceWith(other);
+    std::cout << std::setw(16) << "differenceWith" << std::setw(10) << ms(start) << std::endl;
+
+    other.buildFromSorted(evens.begin(), evens.end());
+    start = std::chrono::steady_clock::now();
+    avl.intersectWith(other);
+    std::cout << std::setw(16) << "intersectWith" << std::setw(10) << ms(start) << std::endl;
+}
+
+/**
+ * @brief Time n shuffled lookups (half of them misses) in an AVL tree of n
+ *        values and in its Eytzinger and van Emde Boas frozen copies
+ * @param n number of values
+ */
+void frozenLookups(unsigned n) {
+    std::vector<int> values(n);
+    for (unsigned i = 0; i < n; ++i)
+        values[i] = 2 * i;
+    std::vector<int> keys = shuffledKeys(2 * n);
+    keys.resize(n);
+
+    AVL<int> avl(nullptr, n);
+    avl.buildFromSorted(values.begin(), values.end());
+    FrozenBST<int> eytzinger = avl.freeze();
+    FrozenBST<int> vanEmdeBoas = avl.freeze(FrozenBST<int>::VAN_EMDE_BOAS);
+
+    std::cout << std::fixed << std::setprecision(1) << n << " lookups in " << n << " values (ns each):" << std::endl;
+    auto time = [&](const char* name, auto find) {
+        unsigned compares = 0, found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int key : keys)
+            found += find(key, compares);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << std::setw(16) << name << std::setw(10) << elapsed.count() / n
+                  << "  (found " << found << ", " << compares << " compares)" << std::endl;
+    };
+    time("AVL", [&](int key, unsigned& compares) { return avl.find(key, compares); });
+    time("Eytzinger", [&](int key, unsigned& compares) { return eytzinger.find(key, compares); });
+    time("van Emde Boas", [&](int key, unsigned& compares) { return vanEmdeBoas.find(key, compares); });
+}
+
+/**
+ * @brief Time n shuffled adds, finds and removes in an AVL tree, one whose
+ *        nodes link by 32-bit handles, and a B-tree
+ * @param n number of keys
+ */
+void btreeVsAvl(unsigned n) {
+    std::vector<int> keys = shuffledKeys(n);
+    std::cout << std::setw(10) << "tree" << std::setw(10) << "add" << std::setw(10) << "find"
+              << std::setw(10) << "remove" << std::setw(8) << "height" << std::setw(10) << "compares"
+              << "  (ms, " << n << " keys, compares per find)" << std::endl;
+    auto time = [&](const char* name, auto& tree) {
+        double ms[3];
+        auto start = std::chrono::steady_clock::now();
+        auto lap = [&](int i) {
+            auto now = std::chrono::steady_clock::now();
+            ms[i] = std::chrono::duration<double, std::milli>(now - start).count();
+            start = now;
+        };
+        for (int key : keys)
+            tree.add(key);
+        lap(0);
+        unsigned compares = 0, found = 0;
+        for (int key : keys)
+            found += tree.find(key, compares);
+        lap(1);
+        int height = tree.height();
+        for (int key : keys)
+            tree.remove(key);
+        lap(2);
+        std::cout << std::setw(10) << name << std::fixed << std::setprecision(1);
+        for (double t : ms)
+            std::cout << std::setw(10) << t;
+        std::cout << std::setw(8) << height << std::setw(10) << compares / double(found) << std::endl;
+    };
+    AVL<int> avl(nullptr, n);
+    time("AVL", avl);
+    AVL<int, HandleLinks> handleAvl(nullptr, n);
+    time("AVL/handle", handleAvl);
+    BTree<int> btree(n);
+    time("BTree", btree);
+}
+
+int main(int argc, char** argv) {
+    unsigned maxKeys = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+
+    insertScaling(maxKeys);
+    std::cout << std::endl;
+    churn(std::min(maxKeys, 1000000u));
+    std::cout << std::endl;
+    setOperations(std::min(maxKeys, 1000000u));
+    std::cout << std::endl;
+    frozenLookups(maxKeys);
+    std::cout << std::endl;
+    btreeVsAvl(std::min(maxKeys, 1000000u));
+    return 0;
+}
@@ -14,6 +14,7 @@
 #define FUDGE 4
 
 #include "AVL.h"
+#include "BTree.h"
 #include "SimpleAllocator.h"
 #include "prng.h"
 #include <iostream>
@@ -25,6 +26,9 @@
 #include <typeinfo>
 #include <sstream>
 #include <cstring>
+#include <thread>
+#include <iterator>
+#include <utility>
 
 using std::cout;
 using std::endl;
@@ -254,7 +258,7 @@ template <typename T> void printAVL(const AVL<T>& avl, bool showCounts = false)
  * Print some AVL overall stats
  * @param avl AVL to print stats
  */
-template <typename T> void printStats(const AVL<T>& tree) {
+template <typename T, typename Links> void printStats(const AVL<T, Links>& tree) {
     // get the type of AVL
     std::string type = std::strstr(typeid(tree).name(), "AVL") ? "AVL" : "BST";
 
@@ -473,6 +477,635 @@ void findInt(AVL<T>& avl, int val) {
     cout << endl;
 }
 
+/**
+ * @brief Print every node of an AVL by index using operator[]
+ *        - each lookup follows the cached subtree counts
+ * @param avl AVL to print
+ */
+template <typename T>
+void printByIndex(const AVL<T>& avl) {
+    try {
+        cout << "By index:";
+        for (unsigned i = 0; i < avl.size(); ++i)
+            cout << " " << avl[i]->data;
+        cout << endl;
+
+        // one past the end must still be rejected
+        avl[avl.size()];
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Walk an AVL with its iterators and run some range queries
+ * @param avl AVL to walk
+ * @param lo smallest value of the range queries
+ * @param hi largest value of the range queries
+ */
+template <typename T>
+void rangeTest(const AVL<T>& avl, const T& lo, const T& hi) {
+    cout << "Forward:";
+    for (typename AVL<T>::const_iterator it = avl.begin(); it != avl.end(); ++it)
+        cout << " " << *it;
+    cout << endl;
+
+    cout << "Backward:";
+    for (typename AVL<T>::const_iterator it = avl.end(); it != avl.begin();)
+        cout << " " << *--it;
+    cout << endl;
+
+    typename AVL<T>::const_iterator lower = avl.lower_bound(lo);
+    typename AVL<T>::const_iterator upper = avl.upper_bound(hi);
+    cout << "lower_bound(" << lo << "): " << (lower == avl.end() ? "end" : std::to_string(*lower))
+         << ", upper_bound(" << hi << "): " << (upper == avl.end() ? "end" : std::to_string(*upper)) << endl;
+
+    cout << "In [" << lo << ", " << hi << "]:";
+    avl.forEachInRange(lo, hi, [](const T& value) { cout << " " << value; });
+    cout << endl << endl;
+}
+
+/**
+ * @brief Bulk-load an AVL from sorted ints, then try an unsorted range
+ * @param avl AVL to load
+ * @param size number of sorted ints
+ */
+template <typename T>
+void buildTest(AVL<T>& avl, int size) {
+    try {
+        cout << "Running buildFromSorted..." << endl << endl;
+        std::vector<T> sorted;
+        for (int i = 0; i < size; ++i)
+            sorted.push_back(i);
+        avl.buildFromSorted(sorted.begin(), sorted.end());
+        cout << "AVL after building from " << size << " sorted elements:" << endl << endl;
+        printStats(avl);
+        printAVL(avl);
+
+        // still a valid AVL tree to add to
+        avl.add(size);
+        cout << "AVL after adding " << size << ":" << endl << endl;
+        printStats(avl);
+        printAVL(avl);
+
+        std::swap(sorted[0], sorted[size - 1]);
+        avl.buildFromSorted(sorted.begin(), sorted.end());
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    printStats(avl);
+    cout << endl;
+}
+
+/**
+ * @brief Run some order-statistics queries on an AVL
+ * @param avl AVL to query
+ */
+template <typename T>
+void orderStatisticsTest(const AVL<T>& avl) {
+    try {
+        unsigned size = avl.size();
+        cout << "select: min " << avl.select(0) << ", median " << avl.select(size / 2)
+             << ", 90th percentile " << avl.select(size * 9 / 10) << ", max " << avl.select(size - 1) << endl;
+        cout << "rank:";
+        for (T value = 0; value <= 40; value += 10)
+            cout << " " << value << "->" << avl.rank(value);
+        cout << endl;
+        cout << "countRange: [5, 15] " << avl.countRange(5, 15) << ", [0, 40] " << avl.countRange(0, 40)
+             << ", [15, 5] " << avl.countRange(15, 5) << endl;
+        avl.select(size);
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Split an AVL at a key and join the halves back
+ * @param avl AVL to split
+ * @param key value to split at
+ */
+template <typename T>
+void splitJoinTest(AVL<T>& avl, const T& key) {
+    try {
+        AVL<T> left, right;
+        avl.split(key, left, right);
+        cout << "Left of split at " << key << ":" << endl << endl;
+        printStats(left);
+        printAVL(left);
+        cout << "Right of split at " << key << ":" << endl << endl;
+        printStats(right);
+        printAVL(right);
+
+        avl.join(left, right);
+        cout << "Joined back:" << endl << endl;
+        printStats(avl);
+        printAVL(avl);
+
+        // splitting into one tree twice would lose one half
+        try {
+            avl.split(key, left, left);
+        } catch (const BSTException& e) {
+            cout << "Split into one tree: " << e.what() << ", size still " << avl.size() << endl << endl;
+        }
+
+        // the order is checked before anything moves
+        avl.split(key, left, right);
+        avl.join(right, left);
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Run the set operations on an AVL of 0..size-1 and the multiples of 3
+ * @param size number of ints in the first tree
+ */
+void setOperationTest(int size) {
+    try {
+        const char* names[] = { "unionWith", "intersectWith", "differenceWith" };
+        for (int op = 0; op < 3; ++op) {
+            AVL<int> avl;
+            AVL<int> other(avl); // shares the pool, so the nodes move over
+            for (int i = 0; i < size; ++i)
+                avl.add(i);
+            for (int i = 0; i < size * 2; i += 3)
+                other.add(i);
+
+            if (op == 0)
+                avl.unionWith(other);
+            else if (op == 1)
+                avl.intersectWith(other);
+            else
+                avl.differenceWith(other);
+            cout << names[op] << ": " << avl.printInorder().str() << "(other size: " << other.size() << ")" << endl;
+            printStats(avl);
+            printAVL(avl);
+        }
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Run the set operations on AVL trees too big for the printed test
+ *        - above AVL::PARALLEL_CUTOFF the halves of the recursion run as
+ *          separate tasks, so the results are checked against std::set_*
+ * @param size number of values in the first tree (the second gets the
+ *             multiples of 3 below 2 * size)
+ */
+void largeSetOperationTest(int size) {
+    try {
+        const char* names[] = { "unionWith", "intersectWith", "differenceWith" };
+        std::vector<int> first, second;
+        for (int i = 0; i < size; ++i)
+            first.push_back(i);
+        for (int i = 0; i < size * 2; i += 3)
+            second.push_back(i);
+        cout << "Sizes " << first.size() << " and " << second.size() << ", above the cutoff of "
+             << AVL<int>::PARALLEL_CUTOFF << ": " << (first.size() + second.size() > AVL<int>::PARALLEL_CUTOFF) << endl;
+
+        for (int op = 0; op < 3; ++op) {
+            AVL<int> avl;
+            AVL<int> other(avl); // shares the pool, so the nodes move over
+            for (int value : first)
+                avl.add(value);
+            for (int value : second)
+                other.add(value);
+
+            std::vector<int> expected;
+            if (op == 0) {
+                avl.unionWith(other);
+                std::set_union(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected));
+            } else if (op == 1) {
+                avl.intersectWith(other);
+                std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected));
+            } else {
+                avl.differenceWith(other);
+                std::set_difference(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected));
+            }
+
+            std::vector<int> result;
+            for (unsigned i = 0; i < avl.size(); ++i)
+                result.push_back(avl[i]->data);
+            cout << names[op] << ": size " << avl.size() << ", height " << avl.height()
+                 << ", matches the std algorithm: " << (result == expected) << " (other size: " << other.size() << ")" << endl;
+        }
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Print the stats of the allocator the tree nodes come from
+ * @param allocator allocator to print stats
+ */
+void printAllocatorStats(const SimpleAllocator& allocator) {
+    SimpleAllocatorStats stats = allocator.getStats();
+    cout << "allocator: pages: " << stats.pagesInUse << ", in use: " << stats.objectsInUse
+         << ", free: " << stats.freeObjects << ", most: " << stats.mostObjects << endl;
+}
+
+/**
+ * @brief Move, swap and copy-assign AVL trees sharing an allocator
+ *        - the allocator stats show which of them allocate nodes
+ */
+void moveSwapTest() {
+    try {
+        SimpleAllocatorConfig config(false, 8, 4);
+        SimpleAllocator allocator(sizeof(AVL<int>::BinTreeNode), config);
+        AVL<int> avl(&allocator);
+        for (int i = 0; i < 10; ++i)
+            avl.add(i);
+        printAllocatorStats(allocator);
+
+        AVL<int> moved(std::move(avl));
+        cout << "After move construction: moved size: " << moved.size() << ", source size: " << avl.size() << endl;
+        printAllocatorStats(allocator);
+
+        AVL<int> other(&allocator);
+        for (int i = 100; i < 106; ++i)
+            other.add(i);
+        moved.swap(other);
+        cout << "After swap: moved: " << moved.printInorder().str() << "| other: " << other.printInorder().str() << endl;
+        printAllocatorStats(allocator);
+
+        // 6 nodes are reused, only the other 4 are allocated
+        unsigned allocations = allocator.getStats().allocations;
+        moved = other;
+        cout << "After copy assignment: moved: " << moved.printInorder().str() << "| new allocations: "
+             << allocator.getStats().allocations - allocations << endl;
+        printStats(moved);
+        printAllocatorStats(allocator);
+
+        other = std::move(moved);
+        cout << "After move assignment: other size: " << other.size() << ", moved size: " << moved.size() << endl;
+        printAllocatorStats(allocator);
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Clear deep copies of an AVL tree on another thread while the tree
+ *        grows: a deep copy has a pool of its own, so nothing is shared
+ *        (run under a thread sanitizer to check)
+ * @param size number of values in the tree before and after
+ */
+void deepCopyThreadTest(int size) {
+    try {
+        AVL<int> avl;
+        for (int i = 0; i < size; ++i)
+            avl.add(i * 2);
+        AVL<int> copy(avl);
+        AVL<int> assigned;
+        assigned = avl;
+
+        std::thread other([&copy, &assigned]() {
+            copy.clear();
+            assigned.clear();
+        });
+        for (int i = 0; i < size; ++i)
+            avl.add(i * 2 + 1);
+        other.join();
+        cout << "Deep copies cleared on another thread while the tree grew: sizes " << avl.size() << ", "
+             << copy.size() << ", " << assigned.size() << endl;
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Take a copy-on-write snapshot of an AVL tree and change the tree
+ *        - the allocator stats show that only the changed paths are copied,
+ *          and that failed changes copy nothing
+ * @param size number of values in the tree
+ */
+void copyOnWriteTest(int size) {
+    try {
+        SimpleAllocatorConfig config(false, 64, UINT_MAX);
+        SimpleAllocator allocator(sizeof(AVL<int>::BinTreeNode), config);
+        AVL<int> avl(&allocator);
+        for (int i = 0; i < size; ++i)
+            avl.add(i);
+        avl.enableCopyOnWrite();
+        printAllocatorStats(allocator);
+
+        unsigned allocations = allocator.getStats().allocations;
+        AVL<int> snapshot(avl);
+        cout << "After taking a snapshot: new allocations: " << allocator.getStats().allocations - allocations << endl;
+
+        // failed changes copy no nodes
+        BST<int> bst(&allocator);
+        for (int i = 0; i < 8; ++i)
+            bst.add(i);
+        bst.enableCopyOnWrite();
+        BST<int> bstSnapshot(bst);
+        allocations = allocator.getStats().allocations;
+        try {
+            bst.add(3);
+        } catch (const BSTException&) {
+        }
+        try {
+            avl.remove(-1);
+        } catch (const BSTException&) {
+        }
+        cout << "After a duplicate add and a remove of a missing value: new allocations: "
+             << allocator.getStats().allocations - allocations << endl;
+        bstSnapshot.clear();
+        bst.clear();
+
+        allocations = allocator.getStats().allocations;
+        for (int i = 0; i < 4; ++i) {
+            avl.remove(i * 10);
+            avl.add(size + i);
+        }
+        cout << "After 4 removes and 4 adds: new allocations: " << allocator.getStats().allocations - allocations << endl;
+        printStats(avl);
+        unsigned compares = 0;
+        cout << "Snapshot size: " << snapshot.size() << ", height: " << snapshot.height()
+             << ", has 0: " << snapshot.find(0, compares) << ", has " << size << ": "
+             << snapshot.find(size, compares) << endl;
+        printAllocatorStats(allocator);
+
+        snapshot.clear();
+        cout << "After dropping the snapshot:" << endl;
+        printAllocatorStats(allocator);
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Freeze an AVL tree into both layouts and find values in each
+ *        - for a perfect tree the frozen ones have the same shape,
+ *          so the compares must match the AVL tree's
+ * @param avl tree to freeze
+ * @param values values to find
+ */
+template <typename T>
+void freezeTest(const AVL<T>& avl, const std::vector<T>& values) {
+    try {
+        FrozenBST<T> eytzinger = avl.freeze();
+        FrozenBST<T> vanEmdeBoas = avl.freeze(FrozenBST<T>::VAN_EMDE_BOAS);
+        cout << "Frozen size: " << eytzinger.size() << ", height: " << eytzinger.height()
+             << " (van Emde Boas size: " << vanEmdeBoas.size() << ", height: " << vanEmdeBoas.height() << ")" << endl;
+        for (const T& value : values) {
+            unsigned avlCompares = 0, eytzingerCompares = 0, vanEmdeBoasCompares = 0;
+            bool found = avl.find(value, avlCompares);
+            cout << "Value " << value << " found: " << found << ", compares: AVL " << avlCompares;
+            found = eytzinger.find(value, eytzingerCompares);
+            cout << " | Eytzinger " << found << ", " << eytzingerCompares;
+            found = vanEmdeBoas.find(value, vanEmdeBoasCompares);
+            cout << " | van Emde Boas " << found << ", " << vanEmdeBoasCompares << endl;
+        }
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Build the same AVL tree with pointer and with handle links
+ *        - the handle nodes are smaller, but the trees must behave the same
+ * @param size number of shuffled ints to add
+ */
+void handleLinksTest(int size) {
+    try {
+        cout << "Node size with pointer links: " << sizeof(AVL<int>::BinTreeNode)
+             << ", with handle links: " << sizeof(AVL<int, HandleLinks>::BinTreeNode) << endl;
+        AVL<int> pointerAvl;
+        AVL<int, HandleLinks> handleAvl;
+        std::vector<int> ints(size);
+        generateShuffledInts(size, ints.data());
+        for (int value : ints) {
+            pointerAvl.add(value);
+            handleAvl.add(value);
+        }
+        for (int i = 0; i < size; i += 3) {
+            pointerAvl.remove(i);
+            handleAvl.remove(i);
+        }
+        printStats(pointerAvl);
+        printStats(handleAvl);
+        cout << "Same values in order: "
+             << (pointerAvl.printInorder().str() == handleAvl.printInorder().str()) << endl;
+        for (int value : { 1, size / 2, size - 1, size }) {
+            unsigned pointerCompares = 0, handleCompares = 0;
+            bool found = pointerAvl.find(value, pointerCompares);
+            cout << "Value " << value << " found: " << found << " in " << pointerCompares << " compares";
+            found = handleAvl.find(value, handleCompares);
+            cout << " | with handles: " << found << " in " << handleCompares << " compares" << endl;
+        }
+        cout << "By index: [0] " << handleAvl[0]->data << ", [" << handleAvl.size() - 1 << "] "
+             << handleAvl[handleAvl.size() - 1]->data << endl;
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Run the BST interface on a B-tree of shuffled ints
+ *        - a small B makes the tree a few levels deep
+ * @param size number of ints to add
+ */
+template <unsigned B>
+void btreeTest(int size) {
+    try {
+        BTree<int, B> btree;
+        std::vector<int> ints(size);
+        generateShuffledInts(size, ints.data());
+        for (int value : ints)
+            btree.add(value);
+        cout << "BTree<int, " << B << "> after adding " << size << " shuffled elements:" << endl;
+        cout << "height: " << btree.height() << ", size: " << btree.size() << endl;
+        for (int value : { 0, size / 2, size - 1, size }) {
+            unsigned compares = 0;
+            bool found = btree.find(value, compares);
+            cout << "Value " << value << " found: " << found << " in " << compares << " compares" << endl;
+        }
+
+        for (int i = 0; i < size; i += 2)
+            btree.remove(i);
+        cout << "After removing the even elements: height: " << btree.height() << ", size: " << btree.size() << endl;
+        int last = btree.size() - 1;
+        cout << "By index: [0] " << btree[0] << ", [" << last / 2 << "] " << btree[last / 2]
+             << ", [" << last << "] " << btree[last] << endl;
+
+        try {
+            btree.add(1);
+        } catch (BSTException& e) {
+            cout << "  !!! BSTException: " << e.what() << endl;
+        }
+        try {
+            btree.remove(0);
+        } catch (BSTException& e) {
+            cout << "  !!! BSTException: " << e.what() << endl;
+        }
+
+        btree.clear();
+        cout << "After clear: height: " << btree.height() << ", size: " << btree.size()
+             << ", empty: " << btree.empty() << endl;
+        btree[0];
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Run every operation on a plain BST built from sorted keys
+ *        - the tree degenerates into a list as deep as it is large,
+ *          which the iterative operations must handle without recursion
+ * @param size number of sorted keys to add
+ */
+void degenerateTest(int size) {
+    try {
+        BST<int> bst;
+        for (int i = 0; i < size; ++i)
+            bst.add(i);
+        unsigned compares = 0;
+        bool found = bst.find(size - 1, compares);
+        cout << "BST after adding " << size << " sorted elements:" << endl;
+        cout << "height: " << bst.height() << ", size: " << bst.size()
+             << ", last found: " << found << " in " << compares << " compares"
+             << ", last by index: " << bst[size - 1]->data << endl;
+
+        BST<int> copy(bst);
+        for (int i = 0; i < size; i += 2)
+            bst.remove(i);
+        cout << "BST after removing the even elements:" << endl;
+        cout << "height: " << bst.height() << ", size: " << bst.size()
+             << ", copy height: " << copy.height() << ", copy size: " << copy.size() << endl;
+
+        copy.clear();
+        cout << "Copy empty after clear: " << copy.empty() << endl;
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * @brief Run the walks down a tree far deeper than a recursion could go
+ *        - adding sorted keys one by one is O(n^2), so the chain is grown
+ *          by joining each next key on top in O(1), which gives the tree
+ *          adding them in descending order would (every node a left child)
+ *        - the add, find, operator[] and remove below walk the whole chain;
+ *          copy and clear visit every node
+ * @param size number of ints in the chain
+ */
+void deepTreeTest(int size) {
+    try {
+        SimpleAllocatorConfig config(false, 4096, UINT_MAX);
+        SimpleAllocator allocator(sizeof(BST<int>::BinTreeNode), config);
+        BST<int> bst(&allocator);
+        BST<int> next(&allocator);
+        for (int i = 1; i <= size; ++i) {
+            next.add(i);
+            bst.join(bst, next);
+        }
+
+        bst.add(0);
+        unsigned compares = 0;
+        bool found = bst.find(0, compares);
+        cout << "BST chain of " << size << " ints and one more added at the bottom:" << endl;
+        cout << "height: " << bst.height() << ", size: " << bst.size()
+             << ", bottom found: " << found << " in " << compares << " compares"
+             << ", first by index: " << bst[0]->data << endl;
+
+        BST<int> copy(bst);
+        bst.remove(0);
+        cout << "After removing the bottom: height: " << bst.height() << ", size: " << bst.size()
+             << ", copy height: " << copy.height() << ", copy size: " << copy.size() << endl;
+
+        copy.clear();
+        bst.clear();
+        cout << "Both empty after clear: " << (copy.empty() && bst.empty()) << endl;
+    }
+    catch (std::exception& e) {
+        // print exception message
+        cout << "  !!! std::exception: " << e.what() << endl;
+    } catch (...) {
+        // print exception message
+        cout << "  !!! Unknown exception" << endl;
+    }
+    cout << endl;
+}
+
 /**
  * The main function that configure and run all the test cases.
  * NOTE that in the practical test, the actual test cases will be
@@ -529,6 +1162,86 @@ int main(int argc, char* argv[]) {
         inorderSS = avl.printInorder();
         cout << "Inorder traversal: " << inorderSS.str() << endl;
         break;
+    case 7:
+        cout << "=== Test indexed access through the cached subtree counts ===" << endl;
+        addInts<int>(avl, 20, false, true);
+        printByIndex(avl);
+        removeInts<int>(avl, false, 8, false, true);
+        printByIndex(avl);
+        break;
+    case 8:
+        cout << "=== Test a degenerate BST built from a large number of sorted ints ===" << endl;
+        degenerateTest(5000);
+        deepTreeTest(500000);
+        break;
+    case 9: {
+        cout << "=== Test an AVL tree running out of its allocator's pages ===" << endl;
+        SimpleAllocatorConfig config(false, 4, 2); // room for 8 nodes
+        SimpleAllocator allocator(sizeof(AVL<int>::BinTreeNode), config);
+        AVL<int> limited(&allocator);
+        addInts<int>(limited, 10, true);
+        printStats(limited);
+        printAllocatorStats(allocator);
+        removeInts<int>(limited, true);
+        printAllocatorStats(allocator);
+        break;
+    }
+    case 10:
+        cout << "=== Test the in-order iterators and range queries ===" << endl;
+        addInts<int>(avl, 20, false, true, true);
+        rangeTest(avl, 7, 23);
+        rangeTest(avl, 50, 60);
+        break;
+    case 11:
+        cout << "=== Test bulk-loading an AVL tree from sorted ints ===" << endl;
+        buildTest<int>(avl, 20);
+        break;
+    case 12:
+        cout << "=== Test the order-statistics queries ===" << endl;
+        addInts<int>(avl, 20);
+        orderStatisticsTest(avl);
+        removeInts<int>(avl, false, 8, false, true);
+        orderStatisticsTest(avl);
+        break;
+    case 13:
+        cout << "=== Test splitting and joining AVL trees ===" << endl;
+        addInts<int>(avl, 20, false, true);
+        splitJoinTest(avl, 6);
+        break;
+    case 14:
+        cout << "=== Test the set operations on AVL trees ===" << endl;
+        setOperationTest(12);
+        largeSetOperationTest(10000);
+        break;
+    case 15:
+        cout << "=== Test moving, swapping and copy-assigning AVL trees ===" << endl;
+        moveSwapTest();
+        deepCopyThreadTest(2000);
+        break;
+    case 16:
+        cout << "=== Test copy-on-write snapshots of an AVL tree ===" << endl;
+        copyOnWriteTest(100);
+        break;
+    case 17: {
+        cout << "=== Test freezing an AVL tree into flat layouts ===" << endl;
+        std::vector<int> sorted;
+        for (int i = 0; i < 15; ++i)
+            sorted.push_back(i);
+        AVL<int> avl;
+        avl.buildFromSorted(sorted.begin(), sorted.end());
+        printAVL(avl);
+        freezeTest(avl, std::vector<int>{ 7, 0, 14, 5, -1, 15, 8 });
+        break;
+    }
+    case 18:
+        cout << "=== Test the B-tree with the BST interface ===" << endl;
+        btreeTest<3>(40);
+        btreeTest<btreeDefaultOrder<int>()>(1000);
+        break;
+    case 19:
+        cout << "=== Test AVL trees whose nodes link by 32-bit handles ===" << endl;
+        handleLinksTest(1000);
+        break;
     default:
         cout << "Please select a valid test." << endl;
         break;
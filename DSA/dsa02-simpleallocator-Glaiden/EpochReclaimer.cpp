@@ -0,0 +1,136 @@
+#include "EpochReclaimer.h"
+#include <exception>
+
+EpochReclaimer::EpochReclaimer(SimpleAllocator* allocator, size_t batchSize)
+    : allocator_(allocator), batchSize_(batchSize > 0 ? batchSize : 1), sinceReclaim_(0), globalEpoch_(0) {
+    for (unsigned i = 0; i < MAX_READERS; ++i)
+    {
+        readers_[i].state.store(0);
+        readers_[i].registered.store(false);
+    }
+}
+
+EpochReclaimer::~EpochReclaimer() {
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        for (void* pObj : limbo_[i])
+        {
+            try
+            {
+                allocator_->free(pObj);
+            }
+            catch (const SimpleAllocatorException&)
+            {
+                //never throws, a corrupted block is dropped
+            }
+        }
+        limbo_[i].clear();
+    }
+}
+
+unsigned EpochReclaimer::registerReader() {
+    for (unsigned i = 0; i < MAX_READERS; ++i)
+    {
+        bool expected = false;
+        if (readers_[i].registered.compare_exchange_strong(expected, true))
+        {
+            readers_[i].state.store(0);
+            return i;
+        }
+    }
+    throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when registering reader: all reader slots are taken.");
+}
+
+void EpochReclaimer::unregisterReader(unsigned slot) {
+    readers_[slot].state.store(0, std::memory_order_release);
+    readers_[slot].registered.store(false, std::memory_order_release);
+}
+
+void EpochReclaimer::enter(unsigned slot) {
+    //seq_cst so the published epoch is visible before any read of the structure
+    readers_[slot].state.store((globalEpoch_.load() << 1) | 1);
+}
+
+void EpochReclaimer::leave(unsigned slot) {
+    readers_[slot].state.store(0, std::memory_order_release);
+}
+
+void* EpochReclaimer::allocate(const char* pLabel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocator_->allocate(pLabel);
+}
+
+void EpochReclaimer::retire(void* pObj) {
+    if (pObj == nullptr)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    limbo_[globalEpoch_.load() % 3].push_back(pObj);
+    if (++sinceReclaim_ >= batchSize_)
+    {
+        reclaimLocked();
+    }
+}
+
+unsigned EpochReclaimer::reclaim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reclaimLocked();
+}
+
+unsigned EpochReclaimer::reclaimLocked() {
+    sinceReclaim_ = 0;
+
+    //every reader inside a critical section must have seen the current epoch
+    uint64_t current = globalEpoch_.load();
+    for (unsigned i = 0; i < MAX_READERS; ++i)
+    {
+        uint64_t state = readers_[i].state.load();
+        if ((state & 1) != 0 && (state >> 1) != current)
+        {
+            return 0;
+        }
+    }
+    uint64_t next = current + 1;
+    globalEpoch_.store(next);
+
+    //objects retired in epoch next - 2 are out of every reader's reach
+    //- the batch leaves the limbo list before anything is freed, so a free
+    //  that throws cannot leave freed objects behind to be freed again
+    std::vector<void*> batch;
+    batch.swap(limbo_[(next + 1) % 3]);
+    unsigned freed = 0;
+    std::exception_ptr error;
+    for (void* pObj : batch)
+    {
+        try
+        {
+            allocator_->free(pObj);
+            ++freed;
+        }
+        catch (const SimpleAllocatorException&)
+        {
+            //a corrupted block is dropped, the rest of the batch still goes back
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    batch.clear();
+    limbo_[(next + 1) % 3].swap(batch); //keeps the capacity for the next round
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return freed;
+}
+
+size_t EpochReclaimer::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limbo_[0].size() + limbo_[1].size() + limbo_[2].size();
+}
+
+uint64_t EpochReclaimer::epoch() const {
+    return globalEpoch_.load();
+}
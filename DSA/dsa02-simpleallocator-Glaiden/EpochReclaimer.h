@@ -0,0 +1,158 @@
+/**
+ * @file EpochReclaimer.h
+ * @brief EpochReclaimer class definition
+ *        Epoch-based deferred reclamation on top of a SimpleAllocator, so
+ *        that readers can keep using objects a writer has already removed
+ *        from a shared structure (e.g. tree nodes) until they move on
+ * @date 19 Oct 2026
+ */
+
+#ifndef EPOCHRECLAIMER_H
+#define EPOCHRECLAIMER_H
+#include "SimpleAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * The EpochReclaimer class
+ * - readers bracket every access with enter()/leave() (or a Guard),
+ *   which only publishes the global epoch in the reader's own slot
+ * - retire() puts an object on the limbo list of the current epoch
+ *   instead of freeing it
+ * - the global epoch only advances once every active reader has seen it,
+ *   so objects retired two epochs ago can no longer be referenced and
+ *   their whole limbo list is freed as one batch
+ * - SimpleAllocator itself is not thread safe, so the writer(s) should
+ *   allocate through allocate() which shares the reclaimer's lock
+ */
+class EpochReclaimer {
+public:
+    // Maximum number of registered readers
+    static const unsigned MAX_READERS = 64;
+
+    /**
+     * Constructor
+     * @param allocator the allocator retired objects are freed to
+     * @param batchSize number of retirements between reclamation attempts
+     */
+    EpochReclaimer(SimpleAllocator* allocator, size_t batchSize = 64);
+
+    /**
+     * Destructor
+     * - frees every object still retired, so no reader may be active
+     * (never throws)
+     */
+    ~EpochReclaimer();
+
+    /**
+     * Register a reader thread
+     * @return the reader's slot, passed to enter/leave
+     * @throws SimpleAllocatorException if MAX_READERS are registered
+     */
+    unsigned registerReader();
+
+    /**
+     * Unregister a reader thread (it must not be inside a critical section)
+     * @param slot the reader's slot
+     */
+    void unregisterReader(unsigned slot);
+
+    /**
+     * Enter a read-side critical section
+     * @param slot the reader's slot
+     */
+    void enter(unsigned slot);
+
+    /**
+     * Leave a read-side critical section
+     * @param slot the reader's slot
+     */
+    void leave(unsigned slot);
+
+    /**
+     * RAII helper that enters on construction and leaves on destruction
+     */
+    class Guard {
+    public:
+        Guard(EpochReclaimer& reclaimer, unsigned slot) : reclaimer_(reclaimer), slot_(slot) {
+            reclaimer_.enter(slot_);
+        }
+        ~Guard() { reclaimer_.leave(slot_); }
+
+    private:
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        EpochReclaimer& reclaimer_;
+        unsigned slot_;
+    };
+
+    /**
+     * Allocate from the underlying allocator under the reclaimer's lock
+     * @param label label for memory block (only for EXTERNAL_HEADER)
+     * @return pointer to allocated memory
+     */
+    void* allocate(const char* pLabel = 0);
+
+    /**
+     * Defer freeing an object until no reader can still see it
+     * - the object must already be unreachable for new readers
+     * @param pObj pointer to object to free later
+     * @throws SimpleAllocatorException as reclaim() does, when the
+     *         retirement triggers a reclamation
+     */
+    void retire(void* pObj);
+
+    /**
+     * Try to advance the epoch and free the batch that became safe
+     * - a block whose free throws (e.g. overwritten pad bytes) is dropped,
+     *   the rest of the batch is still freed and nothing is freed twice
+     * @return number of objects freed
+     * @throws SimpleAllocatorException the first error of the batch, once
+     *         the whole batch has been handled
+     */
+    unsigned reclaim();
+
+    /**
+     * Get the number of retired objects not yet freed
+     * @return number of pending objects
+     */
+    size_t pending() const;
+
+    /**
+     * Get the current global epoch
+     * @return global epoch
+     */
+    uint64_t epoch() const;
+
+private:
+    // Disable copy constructor and assignment operator
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    /**
+     * A reader's published state, on its own cache line
+     * - state is (epoch << 1) | 1 while inside a critical section, else 0
+     */
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> state;
+        std::atomic<bool> registered;
+    };
+
+    SimpleAllocator* allocator_; // Allocator retired objects go back to
+    size_t batchSize_; // Retirements between reclamation attempts
+    size_t sinceReclaim_; // Retirements since the last attempt
+    std::atomic<uint64_t> globalEpoch_; // Current global epoch
+    ReaderSlot readers_[MAX_READERS]; // Published reader states
+    std::vector<void*> limbo_[3]; // Retired objects by epoch % 3
+    mutable std::mutex mutex_; // Guards limbo lists and the allocator
+
+    /**
+     * reclaim() with the lock held
+     * @return number of objects freed
+     */
+    unsigned reclaimLocked();
+};
+
+#endif // EPOCHRECLAIMER_H
@@ -0,0 +1,481 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MappedSimpleAllocator.h"
+
+// Identifies a segment laid out by MappedSimpleAllocator
+static const char MAPPED_POOL_MAGIC[8] = "SAPOOL1";
+static const unsigned MAPPED_POOL_VERSION = 3;
+
+struct MappedPoolHeader {
+    char magic[8]; // MAPPED_POOL_MAGIC, written last when creating
+    unsigned version; // MAPPED_POOL_VERSION
+    unsigned headerSize; // sizeof(MappedPoolHeader) of the creator
+    unsigned pointerSize; // sizeof(void*) of the creator
+    unsigned objectsPerPage; // Number of objects per page
+    unsigned maxPages; // Maximum number of pages
+    unsigned padBytesSize; // num bytes in padding
+    unsigned alignment; // objects start on a multiple of this
+    bool isDebug; // Fill blocks with the allocated/freed patterns
+    uint64_t blockSize; // pad + object slot + pad, rounded up to the alignment
+    uint64_t firstPage; // offset of the first page (after this header)
+    MappedOffset freeList; // Head of the free list
+    MappedOffset pageList; // Head of the page list (newest page first)
+    SimpleAllocatorStats stats; // Statistics shared by every process
+    uint64_t baseAddress; // Address the creator mapped the segment at
+    MappedOffset root; // Client's entry point into the pool
+    pthread_mutex_t mutex; // Process-shared lock over all of the above
+};
+
+// Round a size up to a multiple of a power of two
+static uint64_t roundUp(uint64_t size, uint64_t boundary) {
+    return (size + boundary - 1) & ~(boundary - 1);
+}
+
+// Block layout of a pool, computed the same way by its creator and on reopen
+// | next-page offset | pad | object slot | pad | ... | pad | object slot | pad |
+//                          ^ firstBlock       ^ firstBlock + blockSize
+struct MappedGeometry {
+    uint64_t slotSize; // object bytes, at least a free list link
+    uint64_t firstBlock; // offset of the first object in a page
+    uint64_t blockSize; // bytes from one object to the next
+    uint64_t pageSize; // bytes of a page
+    uint64_t firstPage; // offset of the first page (after the header)
+};
+
+// Compute the block layout from the config (alignment a power of two)
+// - a free block holds the next offset, so a slot is never smaller than one
+// - pages, and the objects in them, start on a multiple of the alignment
+static MappedGeometry geometryOf(uint64_t objectSize, uint64_t padsize, uint64_t objectsPerPage, uint64_t alignment) {
+    MappedGeometry geometry;
+    geometry.slotSize = objectSize < sizeof(MappedOffset) ? sizeof(MappedOffset) : objectSize;
+    geometry.firstBlock = roundUp(sizeof(MappedOffset) + padsize, alignment);
+    geometry.blockSize = roundUp(padsize + geometry.slotSize + padsize, alignment);
+    geometry.pageSize = geometry.firstBlock + objectsPerPage * geometry.blockSize;
+    geometry.firstPage = roundUp(sizeof(MappedPoolHeader), alignment);
+    return geometry;
+}
+
+// Check an alignment can be kept: a power of two no larger than a page,
+// which the mapping itself starts on
+static bool isValidAlignment(uint64_t alignment) {
+    return alignment != 0 && (alignment & (alignment - 1)) == 0 &&
+           alignment <= static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Open (or create) the descriptor behind a segment
+static int openSegment(const char* name, int flags, MappedSimpleAllocator::Backing backing) {
+    if (backing == MappedSimpleAllocator::FILE)
+    {
+        return open(name, flags, 0600);
+    }
+    return shm_open(name, flags, 0600);
+}
+
+// Remove the segment behind a descriptor
+static void removeSegment(const char* name, MappedSimpleAllocator::Backing backing) {
+    if (backing == MappedSimpleAllocator::FILE)
+    {
+        unlink(name);
+    }
+    else
+    {
+        shm_unlink(name);
+    }
+}
+
+// Check that an offset is where an object starts, in the pages before end
+static bool isBlockOffset(const MappedPoolHeader& header, MappedOffset offset, uint64_t end) {
+    if (offset < header.firstPage || offset >= end)
+    {
+        return false;
+    }
+    //blocks are laid out back to back, so the boundary check is arithmetic
+    uint64_t inPage = (offset - header.firstPage) % header.stats.pageSize;
+    uint64_t firstBlock = geometryOf(header.stats.objectSize, header.padBytesSize, header.objectsPerPage,
+                                     header.alignment).firstBlock;
+    return inPage >= firstBlock && (inPage - firstBlock) % header.blockSize == 0;
+}
+
+// Check that a header read from a segment of segmentSize bytes describes
+// the layout its creator would have made, and that its offsets point into
+// the pages carved so far
+static bool isConsistent(const MappedPoolHeader& header, uint64_t segmentSize) {
+    const SimpleAllocatorStats& stats = header.stats;
+    uint64_t padsize = header.padBytesSize;
+    unsigned char isDebug; //read as a byte, a bool other than 0/1 is not valid
+    memcpy(&isDebug, &header.isDebug, sizeof(isDebug));
+    if (isDebug > 1 || header.objectsPerPage == 0 || header.maxPages == 0 ||
+        stats.objectSize == 0 || stats.objectSize > segmentSize ||
+        padsize > segmentSize || !isValidAlignment(header.alignment))
+    {
+        return false;
+    }
+
+    //recompute the geometry from the recorded config, as the creator did
+    //(the page size is only used once objectsPerPage is known to fit)
+    MappedGeometry geometry = geometryOf(stats.objectSize, padsize, header.objectsPerPage, header.alignment);
+    uint64_t blockSize = geometry.blockSize;
+    uint64_t firstPage = geometry.firstPage;
+    if (header.blockSize != blockSize || header.firstPage != firstPage || segmentSize < geometry.firstBlock ||
+        header.objectsPerPage > (segmentSize - geometry.firstBlock) / blockSize)
+    {
+        return false;
+    }
+    uint64_t pageSize = geometry.pageSize;
+    if (stats.pageSize != pageSize || segmentSize < firstPage ||
+        header.maxPages > (segmentSize - firstPage) / pageSize ||
+        segmentSize != firstPage + header.maxPages * pageSize)
+    {
+        return false;
+    }
+
+    //pages are carved in order, the newest heads the page list
+    if (stats.pagesInUse == 0 || stats.pagesInUse > header.maxPages ||
+        static_cast<uint64_t>(stats.objectsInUse) + stats.freeObjects !=
+            static_cast<uint64_t>(stats.pagesInUse) * header.objectsPerPage)
+    {
+        return false;
+    }
+    uint64_t carvedEnd = firstPage + stats.pagesInUse * pageSize;
+    if (header.pageList != carvedEnd - pageSize)
+    {
+        return false;
+    }
+    if ((header.freeList != 0) != (stats.freeObjects != 0) ||
+        (header.freeList != 0 && !isBlockOffset(header, header.freeList, carvedEnd)))
+    {
+        return false;
+    }
+    return header.root == 0 || (header.root >= firstPage && header.root < carvedEnd);
+}
+
+MappedSimpleAllocator::MappedSimpleAllocator(const char* name, size_t objectSize, const SimpleAllocatorConfig& config,
+                                             Backing backing)
+    : pBase_(nullptr), length_(0), pHeader_(nullptr), backing_(backing), fileFd_(-1) {
+
+    //objects are aligned for any type unless a boundary is asked for
+    size_t alignment = config.alignmentBoundary > 0 ? config.alignmentBoundary : alignof(std::max_align_t);
+    if (!isValidAlignment(alignment))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "ERROR when creating mapped pool: alignment must be a power of two no larger than a page.");
+    }
+    MappedGeometry geometry = geometryOf(objectSize, config.padBytesSize, config.objectsPerPage, alignment);
+    size_t length = geometry.firstPage + config.maxPages * geometry.pageSize;
+
+    int fd = openSegment(name, O_CREAT | O_EXCL | O_RDWR, backing);
+    if (fd < 0)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when creating mapped pool: open failed.");
+    }
+    if (backing == FILE && flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        close(fd);
+        removeSegment(name, backing);
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when creating mapped pool: flock failed.");
+    }
+    if (ftruncate(fd, static_cast<off_t>(length)) != 0)
+    {
+        close(fd);
+        removeSegment(name, backing);
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when creating mapped pool: ftruncate failed.");
+    }
+    map(fd, length);
+
+    pHeader_->version = MAPPED_POOL_VERSION;
+    pHeader_->headerSize = sizeof(MappedPoolHeader);
+    pHeader_->pointerSize = sizeof(void*);
+    pHeader_->objectsPerPage = config.objectsPerPage;
+    pHeader_->maxPages = config.maxPages;
+    pHeader_->padBytesSize = config.padBytesSize;
+    pHeader_->alignment = static_cast<unsigned>(alignment);
+    pHeader_->isDebug = config.isDebug;
+    pHeader_->blockSize = geometry.blockSize;
+    pHeader_->firstPage = geometry.firstPage;
+    pHeader_->freeList = 0;
+    pHeader_->pageList = 0;
+    pHeader_->stats = SimpleAllocatorStats();
+    pHeader_->stats.objectSize = objectSize;
+    pHeader_->stats.pageSize = geometry.pageSize;
+    pHeader_->baseAddress = reinterpret_cast<uint64_t>(pBase_);
+    pHeader_->root = 0;
+    initLock();
+
+    //first page up front, like SimpleAllocator
+    allocateNewPage();
+    memcpy(pHeader_->magic, MAPPED_POOL_MAGIC, sizeof(MAPPED_POOL_MAGIC));
+}
+
+MappedSimpleAllocator::MappedSimpleAllocator(const char* name, Backing backing)
+    : pBase_(nullptr), length_(0), pHeader_(nullptr), backing_(backing), fileFd_(-1) {
+
+    int fd = openSegment(name, O_RDWR, backing);
+    if (fd < 0)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when attaching mapped pool: open failed.");
+    }
+    //held until the destructor, so no other process can reopen the file
+    //and reset the lock underneath this one
+    if (backing == FILE && flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        close(fd);
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when reopening mapped pool: file is open in another process.");
+    }
+    struct stat info;
+    MappedPoolHeader header;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(MappedPoolHeader) ||
+        pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+    {
+        close(fd);
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when attaching mapped pool: segment too small.");
+    }
+    if (memcmp(header.magic, MAPPED_POOL_MAGIC, sizeof(MAPPED_POOL_MAGIC)) != 0 ||
+        header.version != MAPPED_POOL_VERSION ||
+        header.headerSize != sizeof(MappedPoolHeader) ||
+        header.pointerSize != sizeof(void*))
+    {
+        close(fd);
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "ERROR when attaching mapped pool: not a compatible SimpleAllocator segment.");
+    }
+    if (!isConsistent(header, static_cast<uint64_t>(info.st_size)))
+    {
+        close(fd);
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "ERROR when attaching mapped pool: segment is truncated or corrupt.");
+    }
+
+    //try the creator's address first so raw pointers in the pool stay valid
+    map(fd, static_cast<size_t>(info.st_size), reinterpret_cast<void*>(header.baseAddress));
+    if (backing == FILE)
+    {
+        //the flock shuts everyone else out, a lock left behind by a dead process is stale
+        initLock();
+    }
+}
+
+MappedSimpleAllocator::~MappedSimpleAllocator() {
+    if (pBase_ != nullptr)
+    {
+        flush();
+        munmap(pBase_, length_);
+    }
+    if (fileFd_ >= 0)
+    {
+        close(fileFd_); //releases the flock
+    }
+}
+
+void MappedSimpleAllocator::remove(const char* name, Backing backing) {
+    removeSegment(name, backing);
+}
+
+void MappedSimpleAllocator::flush() {
+    if (backing_ == FILE)
+    {
+        msync(pBase_, length_, MS_SYNC);
+    }
+}
+
+void MappedSimpleAllocator::setRoot(const void* pRoot) {
+    lock();
+    pHeader_->root = toOffset(pRoot);
+    unlock();
+}
+
+void* MappedSimpleAllocator::getRoot() const {
+    return fromOffset(pHeader_->root);
+}
+
+bool MappedSimpleAllocator::isAtOriginalAddress() const {
+    return reinterpret_cast<uint64_t>(pBase_) == pHeader_->baseAddress;
+}
+
+void MappedSimpleAllocator::initLock() {
+    //robust so that a process dying while holding the lock does not wedge the others
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&pHeader_->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void MappedSimpleAllocator::map(int fd, size_t length, void* pHint) {
+    void* mapping = mmap(pHint, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (backing_ == FILE && mapping != MAP_FAILED)
+    {
+        fileFd_ = fd;
+    }
+    else
+    {
+        close(fd);
+    }
+    if (mapping == MAP_FAILED)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when mapping pool: mmap failed.");
+    }
+    pBase_ = static_cast<char*>(mapping);
+    length_ = length;
+    pHeader_ = reinterpret_cast<MappedPoolHeader*>(pBase_);
+}
+
+void MappedSimpleAllocator::lock() const {
+    if (pthread_mutex_lock(&pHeader_->mutex) == EOWNERDEAD)
+    {
+        //the previous owner died mid-operation, the lists are assumed intact
+        pthread_mutex_consistent(&pHeader_->mutex);
+    }
+}
+
+void MappedSimpleAllocator::unlock() const {
+    pthread_mutex_unlock(&pHeader_->mutex);
+}
+
+void* MappedSimpleAllocator::allocate() {
+    lock();
+    try
+    {
+        if (pHeader_->freeList == 0)
+        {
+            allocateNewPage();
+        }
+    }
+    catch (...)
+    {
+        unlock();
+        throw;
+    }
+
+    char* pBlock = pBase_ + pHeader_->freeList;
+    MappedOffset next;
+    memcpy(&next, pBlock, sizeof(MappedOffset));
+    if (next != 0 && !isBlockOffset(*pHeader_, next, length_))
+    {
+        unlock();
+        throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when allocating: free list link points outside the pool.");
+    }
+    pHeader_->freeList = next;
+    if (pHeader_->isDebug)
+    {
+        memset(pBlock, SimpleAllocator::ALLOCATED_PATTERN, pHeader_->stats.objectSize);
+    }
+
+    SimpleAllocatorStats& stats = pHeader_->stats;
+    ++stats.objectsInUse;
+    ++stats.allocations;
+    --stats.freeObjects;
+    if (stats.objectsInUse > stats.mostObjects)
+    {
+        stats.mostObjects = stats.objectsInUse;
+    }
+    unlock();
+    return pBlock;
+}
+
+void MappedSimpleAllocator::free(void* pObj) {
+    if (pObj == nullptr)
+    {
+        return;
+    }
+
+    size_t padsize = pHeader_->padBytesSize;
+    MappedOffset offset = toOffset(pObj);
+    if (offset < pHeader_->firstPage || offset >= length_)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "Error during free: block is not in the shared pool.");
+    }
+    if (!isBlockOffset(*pHeader_, offset, length_))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "Error during free: not on a block boundary in page.");
+    }
+
+    char* pBlock = static_cast<char*>(pObj);
+    size_t objectSize = pHeader_->stats.objectSize;
+    size_t slotSize = std::max(objectSize, sizeof(MappedOffset));
+    if (padsize > 0 &&
+        (!SimpleAllocator::isRegionFilled(pBlock - padsize, padsize, SimpleAllocator::PAD_PATTERN) ||
+         !SimpleAllocator::isRegionFilled(pBlock + slotSize, padsize, SimpleAllocator::PAD_PATTERN)))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when checking pad bytes: memory corrupted around block.");
+    }
+
+    lock();
+    if (pHeader_->isDebug)
+    {
+        memset(pBlock, SimpleAllocator::FREED_PATTERN, objectSize);
+    }
+    memcpy(pBlock, &pHeader_->freeList, sizeof(MappedOffset));
+    pHeader_->freeList = offset;
+
+    --pHeader_->stats.objectsInUse;
+    ++pHeader_->stats.deallocations;
+    ++pHeader_->stats.freeObjects;
+    unlock();
+}
+
+MappedOffset MappedSimpleAllocator::toOffset(const void* pObj) const {
+    if (pObj == nullptr)
+    {
+        return 0;
+    }
+    return static_cast<MappedOffset>(static_cast<const char*>(pObj) - pBase_);
+}
+
+void* MappedSimpleAllocator::fromOffset(MappedOffset offset) const {
+    return offset == 0 ? nullptr : pBase_ + offset;
+}
+
+SimpleAllocatorConfig MappedSimpleAllocator::getConfig() const {
+    SimpleAllocatorConfig config(false, pHeader_->objectsPerPage, pHeader_->maxPages,
+                                 SimpleAllocatorConfig::HeaderBlockInfo(), pHeader_->alignment,
+                                 pHeader_->padBytesSize, pHeader_->isDebug);
+    return config;
+}
+
+SimpleAllocatorStats MappedSimpleAllocator::getStats() const {
+    lock();
+    SimpleAllocatorStats stats = pHeader_->stats;
+    unlock();
+    return stats;
+}
+
+void MappedSimpleAllocator::allocateNewPage() {
+    SimpleAllocatorStats& stats = pHeader_->stats;
+    if (stats.pagesInUse >= pHeader_->maxPages)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_PAGE, "ERROR when allocating new page: maximum number of pages has been allocated.");
+    }
+
+    MappedOffset page = pHeader_->firstPage + stats.pagesInUse * stats.pageSize;
+    char* pPage = pBase_ + page;
+    memcpy(pPage, &pHeader_->pageList, sizeof(MappedOffset));
+    pHeader_->pageList = page;
+
+    size_t padsize = pHeader_->padBytesSize;
+    MappedGeometry geometry = geometryOf(stats.objectSize, padsize, pHeader_->objectsPerPage, pHeader_->alignment);
+    char* blockStart = pPage + geometry.firstBlock;
+    for (unsigned i = 0; i < pHeader_->objectsPerPage; ++i)
+    {
+        if (padsize > 0)
+        {
+            memset(blockStart - padsize, SimpleAllocator::PAD_PATTERN, padsize);
+            memset(blockStart + geometry.slotSize, SimpleAllocator::PAD_PATTERN, padsize);
+        }
+        if (pHeader_->isDebug)
+        {
+            memset(blockStart, SimpleAllocator::UNALLOCATED_PATTERN, stats.objectSize);
+        }
+        memcpy(blockStart, &pHeader_->freeList, sizeof(MappedOffset));
+        pHeader_->freeList = toOffset(blockStart);
+        blockStart += pHeader_->blockSize;
+    }
+
+    ++stats.pagesInUse;
+    stats.freeObjects += pHeader_->objectsPerPage;
+}
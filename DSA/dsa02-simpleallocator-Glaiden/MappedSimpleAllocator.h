@@ -0,0 +1,216 @@
+/**
+ * @file MappedSimpleAllocator.h
+ * @brief MappedSimpleAllocator class definition
+ *        A fixed-size object pool whose pages live in a memory mapping:
+ *        - a POSIX shared memory segment, so that several processes can
+ *          allocate and free from the same pool and hand objects to each
+ *          other without copying
+ *        - a file, so that the pool survives restarts and is simply
+ *          remapped instead of rebuilt
+ * @date 19 Oct 2026
+ */
+
+#ifndef MAPPEDSIMPLEALLOCATOR_H
+#define MAPPEDSIMPLEALLOCATOR_H
+#include "SimpleAllocator.h"
+#include <cstdint>
+
+/**
+ * An offset from the start of the mapped segment
+ * - pointers differ between processes that map the same segment,
+ *   so every link stored inside the segment is an offset instead
+ * - offset 0 is the segment header, so it doubles as the null offset
+ */
+typedef uint64_t MappedOffset;
+
+/**
+ * The header at the start of every mapped segment
+ * - it is shared by all processes attached to the segment
+ */
+struct MappedPoolHeader;
+
+/**
+ * The MappedSimpleAllocator class
+ * - the segment starts with a header recording the layout and config,
+ *   which is checked when attaching/reopening
+ * - pages are carved one after another out of the segment,
+ *   each page being | next-page offset | pad | block | pad | ... |
+ * - a block is at least a MappedOffset, which links it in the free list,
+ *   and starts on alignmentBoundary (alignof(std::max_align_t) if 0,
+ *   a power of two no larger than a page)
+ * - the free list and page list hold MappedOffsets rather than Node*s
+ * - a process-shared (robust) mutex in the header serializes allocate/free,
+ *   so a block allocated in one process can be freed in another
+ * - headers are not supported, only pad bytes (headerBlockInfo is ignored)
+ */
+class MappedSimpleAllocator {
+public:
+    /**
+     * What the segment is backed by
+     */
+    enum Backing {
+        // POSIX shared memory object, gone on reboot or remove()
+        SHARED_MEMORY,
+
+        // regular file, persists across restarts
+        // - a file pool is opened by one process at a time: the file is
+        //   flock()ed for as long as the allocator lives, so its lock can
+        //   safely be reset when it is reopened
+        FILE,
+    };
+
+    /**
+     * Constructor that creates a new segment
+     * - the segment is sized for maxPages pages up front, but pages are
+     *   only carved (and touched) when they are needed
+     * @param name name of the segment (e.g. "/my-pool") or file path
+     * @param objectSize object size
+     * @param config configuration
+     * @param backing shared memory or file
+     * @throws SimpleAllocatorException if the segment cannot be created
+     *         or the alignment cannot be kept
+     */
+    MappedSimpleAllocator(const char* name, size_t objectSize, const SimpleAllocatorConfig& config,
+                          Backing backing = SHARED_MEMORY);
+
+    /**
+     * Constructor that attaches to (or reopens) an existing segment
+     * - the segment's size, geometry and stored offsets are checked against
+     *   its header before anything in it is used, so a truncated or corrupt
+     *   file is refused instead of faulting later
+     * - the mapping is first tried at the address the segment was created
+     *   at, so that raw pointers stored in the pool stay valid if it succeeds
+     * @param name name of the segment or file path
+     * @param backing shared memory or file
+     * @throws SimpleAllocatorException if the segment cannot be mapped,
+     *         a file pool is already open elsewhere (E_NO_MEMORY)
+     *         or the segment is not a consistent pool created by a
+     *         compatible MappedSimpleAllocator (E_BAD_BOUNDARY)
+     */
+    explicit MappedSimpleAllocator(const char* name, Backing backing = SHARED_MEMORY);
+
+    /**
+     * Destructor
+     * - unmaps the segment (and unlocks a file pool), the segment itself
+     *   stays until removed
+     * (never throws)
+     */
+    ~MappedSimpleAllocator();
+
+    /**
+     * Remove a segment by name
+     * - processes still attached keep their mapping
+     * @param name name of the segment or file path
+     * @param backing shared memory or file
+     */
+    static void remove(const char* name, Backing backing = SHARED_MEMORY);
+
+    /**
+     * Write dirty pages of a file-backed pool back to the file
+     * (also done by the destructor)
+     */
+    void flush();
+
+    /**
+     * Record the client's entry point into the pool (e.g. a tree root)
+     * so that it can be found again after reopening
+     * @param pRoot pointer into the segment (or nullptr)
+     */
+    void setRoot(const void* pRoot);
+
+    /**
+     * Get the entry point recorded with setRoot
+     * @return pointer into this process' mapping (or nullptr)
+     */
+    void* getRoot() const;
+
+    /**
+     * Check whether the segment is mapped at the address it was created at
+     * - only then are raw pointers stored inside the pool still valid,
+     *   offsets are valid either way
+     * @return true if mapped at the original address
+     */
+    bool isAtOriginalAddress() const;
+
+    /**
+     * Allocate memory
+     * @return pointer to allocated memory (valid in this process only)
+     * @throws SimpleAllocatorException if all maxPages pages are in use
+     */
+    void* allocate();
+
+    /**
+     * Free (deallocate) memory, possibly allocated by another process
+     * @param pObj pointer to object to deallocate
+     * @throws SimpleAllocatorException if pObj is not a block in the segment
+     *         or its pad bytes have been overwritten
+     */
+    void free(void* pObj);
+
+    /**
+     * Convert a pointer into the segment to an offset other processes can use
+     * @param pObj pointer into the segment (or nullptr)
+     * @return offset from the start of the segment (0 for nullptr)
+     */
+    MappedOffset toOffset(const void* pObj) const;
+
+    /**
+     * Convert an offset received from another process to a local pointer
+     * @param offset offset from the start of the segment (0 for nullptr)
+     * @return pointer into this process' mapping of the segment
+     */
+    void* fromOffset(MappedOffset offset) const;
+
+    /**
+     * Get the configuration parameters struct
+     * @return configuration parameters (as recorded in the segment)
+     */
+    SimpleAllocatorConfig getConfig() const;
+
+    /**
+     * Get statistics struct
+     * @return statistics shared by all attached processes
+     */
+    SimpleAllocatorStats getStats() const;
+
+private:
+    // Disable copy constructor and assignment operator
+    MappedSimpleAllocator(const MappedSimpleAllocator&) = delete;
+    MappedSimpleAllocator& operator=(const MappedSimpleAllocator&) = delete;
+
+    char* pBase_; // Start of this process' mapping of the segment
+    size_t length_; // Length of the mapping in bytes
+    MappedPoolHeader* pHeader_; // Shared header at the start of the segment
+    Backing backing_; // What the segment is backed by
+    int fileFd_; // Descriptor of a FILE pool, flock()ed while open (-1 otherwise)
+
+    /**
+     * Map a segment from an open file descriptor
+     * - a FILE pool's descriptor is kept (and its flock held) in fileFd_,
+     *   any other is closed afterwards
+     * @param fd file descriptor of the segment
+     * @param length number of bytes to map
+     * @param pHint preferred address of the mapping (or nullptr)
+     */
+    void map(int fd, size_t length, void* pHint = nullptr);
+
+    /**
+     * Initialize the process-shared lock in the header
+     */
+    void initLock();
+
+    /**
+     * Carve the next page out of the segment and put its blocks
+     * on the free list (called with the lock held)
+     * @throws SimpleAllocatorException if maxPages pages are in use
+     */
+    void allocateNewPage();
+
+    /**
+     * Acquire / release the process-shared lock in the header
+     */
+    void lock() const;
+    void unlock() const;
+};
+
+#endif // MAPPEDSIMPLEALLOCATOR_H
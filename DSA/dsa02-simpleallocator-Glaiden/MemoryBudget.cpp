@@ -0,0 +1,116 @@
+#include "MemoryBudget.h"
+#include <iomanip>
+
+MemoryBudget::MemoryBudget(size_t limitBytes) : limitBytes_(limitBytes), usedBytes_(0), pools_() {
+}
+
+void MemoryBudget::registerPool(SimpleAllocator* pool, const std::string& name) {
+    pools_.push_back(Pool{pool, PoolUsage{name, 0, 0, 0}});
+}
+
+void MemoryBudget::unregisterPool(SimpleAllocator* pool) {
+    for (size_t i = 0; i < pools_.size(); ++i)
+    {
+        if (pools_[i].pAllocator == pool)
+        {
+            usedBytes_ -= pools_[i].usage.bytes;
+            pools_.erase(pools_.begin() + i);
+            return;
+        }
+    }
+}
+
+bool MemoryBudget::charge(SimpleAllocator* pool, size_t bytes) {
+    //the charging pool is in the middle of allocating, so only the others shrink
+    if (usedBytes_ + bytes > limitBytes_)
+    {
+        shrink(pool);
+    }
+    if (usedBytes_ + bytes > limitBytes_)
+    {
+        return false;
+    }
+
+    usedBytes_ += bytes;
+    Pool* pEntry = find(pool);
+    if (pEntry != nullptr)
+    {
+        pEntry->usage.bytes += bytes;
+        ++pEntry->usage.pages;
+        if (pEntry->usage.bytes > pEntry->usage.peakBytes)
+        {
+            pEntry->usage.peakBytes = pEntry->usage.bytes;
+        }
+    }
+    return true;
+}
+
+void MemoryBudget::release(SimpleAllocator* pool, size_t bytes) {
+    usedBytes_ -= bytes;
+    Pool* pEntry = find(pool);
+    if (pEntry != nullptr)
+    {
+        pEntry->usage.bytes -= bytes;
+        --pEntry->usage.pages;
+    }
+}
+
+size_t MemoryBudget::shrink(SimpleAllocator* pExcept) {
+    size_t before = usedBytes_;
+    for (size_t i = 0; i < pools_.size(); ++i)
+    {
+        if (pools_[i].pAllocator == pExcept)
+        {
+            continue;
+        }
+        try
+        {
+            //releasing calls back into release()
+            pools_[i].pAllocator->freeEmptyPages();
+        }
+        catch (const SimpleAllocatorException&)
+        {
+            //a corrupted quarantined block is that pool's problem, try the next
+        }
+    }
+    return before - usedBytes_;
+}
+
+size_t MemoryBudget::getLimit() const {
+    return limitBytes_;
+}
+
+size_t MemoryBudget::getUsed() const {
+    return usedBytes_;
+}
+
+std::vector<MemoryBudget::PoolUsage> MemoryBudget::getUsage() const {
+    std::vector<PoolUsage> usage;
+    for (const Pool& pool : pools_)
+    {
+        usage.push_back(pool.usage);
+    }
+    return usage;
+}
+
+void MemoryBudget::dumpUsage(std::ostream& os) const {
+    os << "memory budget: " << usedBytes_ << " of " << limitBytes_ << " bytes used" << std::endl;
+    os << std::setw(16) << "pool" << std::setw(8) << "pages" << std::setw(10) << "bytes"
+       << std::setw(10) << "peak" << std::endl;
+    for (const Pool& pool : pools_)
+    {
+        os << std::setw(16) << pool.usage.name << std::setw(8) << pool.usage.pages
+           << std::setw(10) << pool.usage.bytes << std::setw(10) << pool.usage.peakBytes << std::endl;
+    }
+}
+
+MemoryBudget::Pool* MemoryBudget::find(const SimpleAllocator* pool) {
+    for (Pool& entry : pools_)
+    {
+        if (entry.pAllocator == pool)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
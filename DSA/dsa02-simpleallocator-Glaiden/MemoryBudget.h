@@ -0,0 +1,130 @@
+/**
+ * @file MemoryBudget.h
+ * @brief MemoryBudget class definition
+ *        A process-wide byte budget shared by several SimpleAllocators,
+ *        replacing a hand-tuned maxPages per pool
+ * @date 19 Oct 2026
+ */
+
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+#include "SimpleAllocator.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * The MemoryBudget class
+ * - an allocator joins the budget through SimpleAllocatorConfig::pBudget,
+ *   every page it allocates is charged against the shared limit and every
+ *   page it releases is given back
+ * - when a page does not fit, the other pools are asked to shrink
+ *   (freeEmptyPages) before the charge fails
+ * - like SimpleAllocator it is not thread safe, pools sharing a budget
+ *   must be used from one thread (or under one lock)
+ * - the budget must outlive every pool registered with it
+ */
+class MemoryBudget {
+public:
+    /**
+     * Usage of one registered pool
+     */
+    struct PoolUsage {
+        std::string name; // pool name given at registration
+        size_t bytes; // bytes of pages currently charged
+        size_t peakBytes; // most bytes charged at once
+        unsigned pages; // pages currently charged
+    };
+
+    /**
+     * Constructor
+     * @param limitBytes byte limit shared by all registered pools
+     */
+    explicit MemoryBudget(size_t limitBytes);
+
+    /**
+     * Register a pool (done by the SimpleAllocator constructor)
+     * @param pool the allocator
+     * @param name name used in usage reports
+     */
+    void registerPool(SimpleAllocator* pool, const std::string& name);
+
+    /**
+     * Unregister a pool (done by the SimpleAllocator destructor)
+     * - whatever it still has charged is given back
+     * @param pool the allocator
+     */
+    void unregisterPool(SimpleAllocator* pool);
+
+    /**
+     * Charge a new page, shrinking the other pools if it does not fit
+     * @param pool the allocator allocating the page
+     * @param bytes size of the page
+     * @return true if the page fits in the budget and has been charged
+     */
+    bool charge(SimpleAllocator* pool, size_t bytes);
+
+    /**
+     * Give back a released page
+     * @param pool the allocator releasing the page
+     * @param bytes size of the page
+     */
+    void release(SimpleAllocator* pool, size_t bytes);
+
+    /**
+     * Ask every pool except one to release its empty pages
+     * @param pExcept pool to leave alone (or nullptr)
+     * @return number of bytes given back
+     */
+    size_t shrink(SimpleAllocator* pExcept = nullptr);
+
+    /**
+     * Get the byte limit
+     * @return byte limit shared by all pools
+     */
+    size_t getLimit() const;
+
+    /**
+     * Get the bytes charged by all pools together
+     * @return bytes in use
+     */
+    size_t getUsed() const;
+
+    /**
+     * Get the usage of every registered pool, in registration order
+     * @return usage per pool
+     */
+    std::vector<PoolUsage> getUsage() const;
+
+    /**
+     * Write the usage of every pool as flat text:  pool | pages | bytes | peak
+     * @param os stream to write to
+     */
+    void dumpUsage(std::ostream& os) const;
+
+private:
+    // Disable copy constructor and assignment operator
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    /**
+     * A registered pool and its usage
+     */
+    struct Pool {
+        SimpleAllocator* pAllocator; // the allocator
+        PoolUsage usage; // what it has charged
+    };
+
+    size_t limitBytes_; // Byte limit shared by all pools
+    size_t usedBytes_; // Bytes charged by all pools together
+    std::vector<Pool> pools_; // Registered pools, in registration order
+
+    /**
+     * Find a registered pool
+     * @param pool the allocator
+     * @return the pool's entry (nullptr if not registered)
+     */
+    Pool* find(const SimpleAllocator* pool);
+};
+
+#endif // MEMORYBUDGET_H
@@ -1,7 +1,31 @@
 #include <string>
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <functional>
 #include "SimpleAllocator.h"
+#include "MemoryBudget.h"
+#include "SimpleAllocatorSnapshot.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define HAS_GUARD_PAGES 1
+#else
+#define HAS_GUARD_PAGES 0 // no mprotect, guard mode falls back to the pages
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#if defined(__GNUC__)
+#define CALLER_ADDRESS() __builtin_return_address(0)
+#else
+#define CALLER_ADDRESS() nullptr // unlabeled samples all share one site
+#endif
 unsigned int allonum = 0;
 
 void SimpleAllocator::corrupttest(char*block)
@@ -9,48 +33,196 @@ void SimpleAllocator::corrupttest(char*block)
     char *ppad = block - config_.padBytesSize; //first chunk of pads
     char*nextpad = block + stats_.objectSize; //last chunk of pads
     
-    for(unsigned int i =0;i<config_.padBytesSize;i++)
+    if(!isRegionFilled(ppad, config_.padBytesSize, PAD_PATTERN))
     {
-        unsigned int temp = ppad[i];
-        // printf("has entered loop, %c\n");
-        if(temp != 4294967261) //compare current byte to 0XDD pattern
+        throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when checking pad bytes: memory corrupted before block.");
+    }
+    if(!isRegionFilled(nextpad, config_.padBytesSize, PAD_PATTERN))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when checking pad bytes: memory corrupted after block.");
+    }
+
+}
+
+const unsigned char* SimpleAllocator::findMismatch(const void* pRegion, size_t size, unsigned char value)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(pRegion);
+    const unsigned char* pEnd = p + size;
+
+    //wide compares only find the chunk, the byte loop below pins the byte
+#if defined(__AVX2__)
+    const __m256i pattern32 = _mm256_set1_epi8(static_cast<char>(value));
+    for (; pEnd - p >= 32; p += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern32)) != -1)
         {
-            throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when checking pad bytes: memory corrupted before block.");
+            break;
         }
-        temp = nextpad[i];
-        if(temp != 4294967261)
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i pattern16 = _mm_set1_epi8(static_cast<char>(value));
+    for (; pEnd - p >= 16; p += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern16)) != 0xFFFF)
         {
-            throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when checking pad bytes: memory corrupted before block.");
+            break;
         }
-        
+    }
+#else
+    const uint64_t pattern8 = 0x0101010101010101ULL * value;
+    for (; pEnd - p >= 8; p += 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word)); //unaligned-safe load
+        if (word != pattern8)
+        {
+            break;
+        }
+    }
+#endif
+    for (; p < pEnd; ++p)
+    {
+        if (*p != value)
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+unsigned SimpleAllocator::dumpCorruptedMemory(DUMPCALLBACK fn) const
+{
+    const SimpleAllocatorConfig::HeaderBlockInfo& headerBlockInfo = config_.headerBlockInfo;
+    size_t padsize = config_.padBytesSize;
+    size_t blockSize = headerBlockInfo.size + padsize + stats_.objectSize + padsize + config_.alignmentBoundary;
+    unsigned corrupted = 0;
+    if (padsize == 0)
+    {
+        return corrupted;
     }
 
+    //same block walk as allocateNewPage
+    for (const Node* page = pPageList_; page != nullptr; page = page->pNext)
+    {
+        const char* currentPage = reinterpret_cast<const char*>(page);
+        unsigned capacity = pageCapacity_[pageNumbers_.find(currentPage)->second];
+        for (unsigned i = 0; i < capacity; ++i)
+        {
+            const char* blockStart = currentPage + headerBlockInfo.size + padsize + 8 + config_.alignmentBoundary;
+            if (!isRegionFilled(blockStart - padsize, padsize, PAD_PATTERN) ||
+                !isRegionFilled(blockStart + stats_.objectSize, padsize, PAD_PATTERN))
+            {
+                fn(blockStart, stats_.objectSize);
+                ++corrupted;
+            }
+            currentPage += blockSize;
+        }
+    }
+    return corrupted;
 }
 
 SimpleAllocator::SimpleAllocator(size_t objectSize, const SimpleAllocatorConfig& config)
-    : config_(config), stats_(), pFreeList_(nullptr), pPageList_(nullptr) {
+    : config_(config), stats_(), pFreeList_(nullptr), pPageList_(nullptr),
+      guardedBlocks_(), guardCounter_(0),
+      pQuarantineHead_(nullptr), pQuarantineTail_(nullptr), quarantinedBytes_(0),
+      profileSites_(), sampledBlocks_(), profileCountdown_(config.profileSampleRate) {
 
     stats_.objectSize = objectSize;
+
+    //block geometry, same as allocateNewPage
+    const SimpleAllocatorConfig::HeaderBlockInfo& headerBlockInfo = config_.headerBlockInfo;
+    blockStride_ = headerBlockInfo.size + 2 * config_.padBytesSize + objectSize + config_.alignmentBoundary;
+    firstBlockOffset_ = headerBlockInfo.size + config_.padBytesSize + 8 + config_.alignmentBoundary;
+    nextPageCapacity_ = config_.objectsPerPage;
+    pageBytes_ = 0;
+    slotBits_ = 0;
+    while ((1u << slotBits_) < std::max(config_.objectsPerPage, config_.maxObjectsPerPage))
+    {
+        ++slotBits_;
+    }
     stats_.mostObjects += config_.objectsPerPage;
     //stats_.pagesInUse++;
-    stats_.freeObjects = config_.objectsPerPage;
-    allocateNewPage();
+    //allocateNewPage counts the first page's objects
+    stats_.freeObjects = 0;
+    if (config_.pBudget != nullptr)
+    {
+        config_.pBudget->registerPool(this, config_.pPoolName != nullptr ? config_.pPoolName : "(unnamed)");
+    }
+    try
+    {
+        allocateNewPage();
+    }
+    catch (const SimpleAllocatorException&)
+    {
+        if (config_.pBudget != nullptr)
+        {
+            config_.pBudget->unregisterPool(this);
+        }
+        throw;
+    }
 }
 
 SimpleAllocator::~SimpleAllocator() {
+#if HAS_GUARD_PAGES
+    for (auto& guarded : guardedBlocks_) {
+        munmap(guarded.second.pMapping, guarded.second.length);
+    }
+#endif
     while (pPageList_ != nullptr) {
         Node* nextpage = pPageList_->pNext;
         delete pPageList_;
         pPageList_ = nextpage;
     }
+    if (config_.pBudget != nullptr)
+    {
+        config_.pBudget->unregisterPool(this);
+    }
 }
 
 void* SimpleAllocator::allocate(const char* pLabel) {
+    if (HAS_GUARD_PAGES && config_.useGuardPages)
+    {
+        //sample 1 in guardSampleRate allocations onto a guard page
+        unsigned rate = config_.guardSampleRate > 0 ? config_.guardSampleRate : 1;
+        if (++guardCounter_ % rate == 0)
+        {
+            void* pGuarded = allocateGuarded();
+            if (config_.profileSampleRate > 0)
+            {
+                profileAllocation(pGuarded, pLabel, CALLER_ADDRESS());
+            }
+            return pGuarded;
+        }
+    }
     if (pFreeList_== nullptr)
     {
-        allocateNewPage();
+        //reuse the oldest quarantined block before going over maxPages
+        if (pQuarantineHead_ != nullptr && pageLimitReached())
+        {
+            evictQuarantined();
+        }
+        else
+        {
+            allocateNewPage();
+        }
     }
     
+    if (config_.checkFreedBlocks && stats_.objectSize > sizeof(Node*))
+    {
+        //a free block holds its link followed by either the freed or unallocated pattern
+        unsigned char* pBytes = reinterpret_cast<unsigned char*>(pFreeList_) + sizeof(Node*);
+        size_t size = stats_.objectSize - sizeof(Node*);
+        unsigned char expected = (pBytes[0] == UNALLOCATED_PATTERN) ? UNALLOCATED_PATTERN : FREED_PATTERN;
+        if (!isRegionFilled(pBytes, size, expected))
+        {
+            memset(pBytes, expected, size); //repair so the block is usable afterwards
+            throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when allocating: free block was written to after being freed.");
+        }
+    }
+
     const SimpleAllocatorConfig::HeaderBlockInfo& headerBlockInfo = config_.headerBlockInfo;
     Node* pAllocatedBlock = pFreeList_;
     char * pAllocatesize = reinterpret_cast<char*>(pAllocatedBlock); // cast to count bytes in 1
@@ -109,9 +281,13 @@ void* SimpleAllocator::allocate(const char* pLabel) {
         MemBlockInfo** header = reinterpret_cast<MemBlockInfo**>(pheader);
         *header = MBI;
     }
-    char *ppad = pheader + (headerBlockInfo.size -1);
-    bool* padpointer = reinterpret_cast<bool*>(ppad);
-    *padpointer = 1;
+    //only basic and extended headers end in an in-use flag
+    if(headerBlockInfo.type == config_.BASIC_HEADER || headerBlockInfo.type == config_.EXTENDED_HEADER)
+    {
+        char *ppad = pheader + (headerBlockInfo.size -1);
+        bool* padpointer = reinterpret_cast<bool*>(ppad);
+        *padpointer = 1;
+    }
     ++stats_.objectsInUse;
     ++stats_.allocations;
 
@@ -120,7 +296,11 @@ void* SimpleAllocator::allocate(const char* pLabel) {
         stats_.mostObjects = stats_.objectsInUse;
     }
     stats_.freeObjects -= 1;
-    
+
+    if (config_.profileSampleRate > 0)
+    {
+        profileAllocation(pAllocatedBlock, pLabel, CALLER_ADDRESS());
+    }
     return pAllocatedBlock;
 }
 
@@ -133,6 +313,14 @@ void SimpleAllocator::free(void* pObj) {
     {
         throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "Error during free: not on a block boundary in page.");
     }
+    if(!sampledBlocks_.empty())
+    {
+        profileFree(pObj);
+    }
+    if(!guardedBlocks_.empty() && freeGuarded(pObj))
+    {
+        return;
+    }
     const SimpleAllocatorConfig::HeaderBlockInfo& headerBlockInfo = config_.headerBlockInfo;
     Node* pBlock = static_cast<Node*>(pObj);//current block //makes a chunk of mem for page
     char *pcurrentblock = reinterpret_cast<char*>(pBlock);
@@ -141,9 +329,12 @@ void SimpleAllocator::free(void* pObj) {
         corrupttest(pcurrentblock);
     }
     memset(pBlock,FREED_PATTERN,stats_.objectSize);
-    pBlock->pNext = pFreeList_; // Update pBlock's next to point to the current head of the free list 
+    if(config_.quarantineBytes == 0)
+    {
+        pBlock->pNext = pFreeList_; // Update pBlock's next to point to the current head of the free list 
     
-    pFreeList_ = pBlock; // Update the free list to point to pBlock
+        pFreeList_ = pBlock; // Update the free list to point to pBlock
+    }
    
     char *pheader = pcurrentblock - headerBlockInfo.size - config_.padBytesSize;
     if(headerBlockInfo.type == config_.BASIC_HEADER)
@@ -180,15 +371,25 @@ void SimpleAllocator::free(void* pObj) {
         }
     }
 
-    char *flag = pheader + (headerBlockInfo.size - 1);
-    bool *flagvalue = reinterpret_cast<bool*>(flag);
-    *flagvalue = false;
+    //only basic and extended headers end in an in-use flag
+    if(headerBlockInfo.type == config_.BASIC_HEADER || headerBlockInfo.type == config_.EXTENDED_HEADER)
+    {
+        char *flag = pheader + (headerBlockInfo.size - 1);
+        bool *flagvalue = reinterpret_cast<bool*>(flag);
+        *flagvalue = false;
+    }
     
     
     --stats_.objectsInUse;
     ++stats_.deallocations;
     // Update the count of free objects
     ++stats_.freeObjects;
+
+    //done last so a stale write found while evicting leaves the stats intact
+    if(config_.quarantineBytes > 0)
+    {
+        quarantine(pBlock);
+    }
 }
 
 
@@ -220,7 +421,16 @@ void SimpleAllocator::allocateNewPage() {
     size_t padsize = config_.padBytesSize;
     size_t object = stats_.objectSize;
     size_t blockSize = headerBlockInfo.size + padsize + object + padsize + alignmentSize; //memory per block
-    size_t pagesize = (config_.objectsPerPage) * blockSize + 8; // total memory value of blocks in page
+    unsigned capacity = nextPageCapacity_;
+    size_t pagesize = capacity * blockSize + 8; // total memory value of blocks in page
+    if (config_.maxBytes > 0 && pageBytes_ + pagesize > config_.maxBytes)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_PAGE, "ERROR when allocating new page: byte budget for pages has been used up.");
+    }
+    if (config_.pBudget != nullptr && !config_.pBudget->charge(this, pagesize))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_PAGE, "ERROR when allocating new page: shared memory budget has been used up.");
+    }
 
     // void* pagemem = new char[pagesize]; // allocate page memory
     // pPageList_ = static_cast<Node*>(pagemem);// pointer to page
@@ -231,13 +441,31 @@ void SimpleAllocator::allocateNewPage() {
     //newPage->pNext = nullptr;
     newPage->pNext = pPageList_;
     pPageList_=newPage;
+    //reuse the page number of a released page if there is one
+    auto released = std::find(pageTable_.begin(), pageTable_.end(), nullptr);
+    pageNumbers_[static_cast<char*>(pagemem)] = static_cast<unsigned>(released - pageTable_.begin());
+    if (released != pageTable_.end())
+    {
+        pageCapacity_[released - pageTable_.begin()] = capacity;
+        *released = static_cast<char*>(pagemem);
+    }
+    else
+    {
+        pageTable_.push_back(static_cast<char*>(pagemem));
+        pageCapacity_.push_back(capacity);
+    }
    
 
     char* currentPage = reinterpret_cast<char*>(pPageList_);
 
-    for (unsigned i = 0; i < config_.objectsPerPage;++i) {
+    for (unsigned i = 0; i < capacity;++i) {
         char* blockStart = currentPage + headerBlockInfo.size + padsize + 8 + alignmentSize;
         memset(blockStart,UNALLOCATED_PATTERN,object);
+        if(headerBlockInfo.type == config_.EXTERNAL_HEADER)
+        {
+            //no MemBlockInfo yet, so a page walk never follows a garbage pointer
+            memset(blockStart - padsize - headerBlockInfo.size, 0, headerBlockInfo.size);
+        }
         if(padsize >0)
         {
             char *ppad = blockStart - padsize;
@@ -255,11 +483,612 @@ void SimpleAllocator::allocateNewPage() {
 
     stats_.pageSize = pagesize;
     stats_.objectSize = object;
-    stats_.mostObjects += config_.objectsPerPage;
+    stats_.mostObjects += capacity;
     ++stats_.pagesInUse;
-    stats_.freeObjects = config_.objectsPerPage;
+    //quarantined objects are still counted as free
+    stats_.freeObjects += capacity;
+    pageBytes_ += pagesize;
+
+    //geometric growth, so small pools stay small and large ones need few pages
+    if (config_.pageGrowthFactor > 1 && capacity < config_.maxObjectsPerPage)
+    {
+        uint64_t grown = static_cast<uint64_t>(capacity) * config_.pageGrowthFactor;
+        nextPageCapacity_ = static_cast<unsigned>(std::min<uint64_t>(grown, config_.maxObjectsPerPage));
+    }
     if(stats_.pagesInUse > config_.maxPages)
     {
         throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when allocating new page: maximum number of pages has been allocated.");
     }
-}
\ No newline at end of file
+}
+
+void* SimpleAllocator::allocateGuarded() {
+#if HAS_GUARD_PAGES
+    size_t pageBytes = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t dataPages = (stats_.objectSize + pageBytes - 1) / pageBytes;
+    if (dataPages == 0)
+    {
+        dataPages = 1;
+    }
+    size_t length = (dataPages + 1) * pageBytes; //readable pages + 1 guard page
+
+    void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when allocating guarded block: mmap failed.");
+    }
+    char* pGuard = static_cast<char*>(mapping) + dataPages * pageBytes;
+    if (mprotect(pGuard, pageBytes, PROT_NONE) != 0)
+    {
+        munmap(mapping, length);
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when allocating guarded block: mprotect failed.");
+    }
+
+    //push the object flush against the guard page, so even a one byte
+    //overrun faults; only an alignmentBoundary the caller asked for leaves
+    //slack in between, which gets the pad pattern and is checked on free
+    size_t offset = stats_.objectSize;
+    if (config_.alignmentBoundary > 1)
+    {
+        offset = (offset + config_.alignmentBoundary - 1) / config_.alignmentBoundary * config_.alignmentBoundary;
+    }
+    char* pObj = pGuard - offset;
+    size_t slack = offset - stats_.objectSize;
+    memset(pObj, ALLOCATED_PATTERN, stats_.objectSize);
+    memset(pObj + stats_.objectSize, PAD_PATTERN, slack);
+    guardedBlocks_[pObj] = GuardedBlock{static_cast<char*>(mapping), length, slack};
+
+    ++stats_.guardedObjects;
+    ++stats_.objectsInUse;
+    ++stats_.allocations;
+    if (stats_.objectsInUse > stats_.mostObjects)
+    {
+        stats_.mostObjects = stats_.objectsInUse;
+    }
+    return pObj;
+#else
+    return nullptr;
+#endif
+}
+
+bool SimpleAllocator::freeGuarded(void* pObj) {
+#if HAS_GUARD_PAGES
+    auto found = guardedBlocks_.find(pObj);
+    if (found == guardedBlocks_.end())
+    {
+        return false;
+    }
+    //an overrun that stayed within the alignment slack did not fault
+    char* pSlack = static_cast<char*>(pObj) + stats_.objectSize;
+    if (!isRegionFilled(pSlack, found->second.slack, PAD_PATTERN))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when checking pad bytes: memory corrupted after guarded block.");
+    }
+    //unmapping also makes any later use of the block fault
+    munmap(found->second.pMapping, found->second.length);
+    guardedBlocks_.erase(found);
+
+    --stats_.guardedObjects;
+    --stats_.objectsInUse;
+    ++stats_.deallocations;
+    return true;
+#else
+    (void)pObj;
+    return false;
+#endif
+}
+
+void SimpleAllocator::quarantine(Node* pBlock) {
+    pBlock->pNext = nullptr;
+    if (pQuarantineTail_ != nullptr)
+    {
+        pQuarantineTail_->pNext = pBlock;
+    }
+    else
+    {
+        pQuarantineHead_ = pBlock;
+    }
+    pQuarantineTail_ = pBlock;
+    quarantinedBytes_ += stats_.objectSize;
+    ++stats_.quarantinedObjects;
+
+    while (quarantinedBytes_ > config_.quarantineBytes)
+    {
+        evictQuarantined();
+    }
+}
+
+void SimpleAllocator::evictQuarantined() {
+    Node* pBlock = pQuarantineHead_;
+    pQuarantineHead_ = pBlock->pNext;
+    if (pQuarantineHead_ == nullptr)
+    {
+        pQuarantineTail_ = nullptr;
+    }
+    quarantinedBytes_ -= stats_.objectSize;
+    --stats_.quarantinedObjects;
+
+    //everything after the link must still be FREED_PATTERN
+    bool intact = stats_.objectSize <= sizeof(Node*) ||
+        isRegionFilled(reinterpret_cast<const char*>(pBlock) + sizeof(Node*), stats_.objectSize - sizeof(Node*), FREED_PATTERN);
+
+    //hand the block back either way so the free list stays consistent
+    memset(pBlock, FREED_PATTERN, stats_.objectSize);
+    pBlock->pNext = pFreeList_;
+    pFreeList_ = pBlock;
+
+    if (!intact)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_CORRUPTED_BLOCK, "ERROR when leaving quarantine: block was written to after being freed.");
+    }
+}
+
+SimpleAllocator::Handle SimpleAllocator::allocateHandle(const char* pLabel) {
+    if (config_.useGuardPages)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "ERROR when allocating handle: handles cannot refer to guarded blocks.");
+    }
+    void* pObj = allocate(pLabel);
+    try
+    {
+        return handleOf(pObj);
+    }
+    catch (const SimpleAllocatorException&)
+    {
+        free(pObj);
+        throw;
+    }
+}
+
+void SimpleAllocator::freeHandle(Handle handle) {
+    free(resolve(handle));
+}
+
+SimpleAllocator::Handle SimpleAllocator::handleOf(const void* pObj) const {
+    if (pObj == nullptr)
+    {
+        return NULL_HANDLE;
+    }
+
+    //the page is the last one starting at or before the object
+    const char* pBlock = static_cast<const char*>(pObj);
+    auto page = pageNumbers_.upper_bound(pBlock);
+    if (page == pageNumbers_.begin())
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "ERROR when getting handle: block is not on a page.");
+    }
+    --page;
+    size_t offset = static_cast<size_t>(pBlock - page->first);
+    size_t slot = (offset - firstBlockOffset_) / blockStride_;
+    if (offset < firstBlockOffset_ || (offset - firstBlockOffset_) % blockStride_ != 0 ||
+        slot >= pageCapacity_[page->second])
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "ERROR when getting handle: not on a block boundary in page.");
+    }
+    uint64_t pageNumber = static_cast<uint64_t>(page->second) + 1;
+    if (pageNumber >= (uint64_t(1) << (32 - slotBits_)))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_PAGE, "ERROR when getting handle: page number does not fit in a handle.");
+    }
+    return static_cast<Handle>((pageNumber << slotBits_) | slot);
+}
+
+std::vector<std::vector<bool>> SimpleAllocator::findFreeSlots() const {
+    std::vector<std::vector<bool>> freeSlots(pageTable_.size());
+    for (size_t page = 0; page < pageTable_.size(); ++page)
+    {
+        if (pageTable_[page] != nullptr)
+        {
+            freeSlots[page].assign(pageCapacity_[page], false);
+        }
+    }
+
+    //quarantined blocks are not in use either
+    const Node* lists[] = {pFreeList_, pQuarantineHead_};
+    for (const Node* pList : lists)
+    {
+        for (const Node* pBlock = pList; pBlock != nullptr; pBlock = pBlock->pNext)
+        {
+            const char* pcurrentblock = reinterpret_cast<const char*>(pBlock);
+            auto page = --pageNumbers_.upper_bound(pcurrentblock);
+            size_t slot = (static_cast<size_t>(pcurrentblock - page->first) - firstBlockOffset_) / blockStride_;
+            freeSlots[page->second][slot] = true;
+        }
+    }
+    return freeSlots;
+}
+
+SimpleAllocatorOccupancy SimpleAllocator::getOccupancy() const {
+    SimpleAllocatorOccupancy occupancy;
+    occupancy.histogram.assign(std::max(config_.objectsPerPage, config_.maxObjectsPerPage) + 1, 0);
+
+    unsigned objectsOnPages = 0;
+    std::vector<unsigned> capacities;
+    std::vector<std::vector<bool>> freeSlots = findFreeSlots();
+    for (const std::vector<bool>& slots : freeSlots)
+    {
+        if (slots.empty())
+        {
+            continue;
+        }
+        unsigned inUse = static_cast<unsigned>(std::count(slots.begin(), slots.end(), false));
+        ++occupancy.histogram[inUse];
+        ++occupancy.pagesInUse;
+        objectsOnPages += inUse;
+        capacities.push_back(static_cast<unsigned>(slots.size()));
+    }
+    if (occupancy.pagesInUse > 0)
+    {
+        //packing fills the largest pages first
+        std::sort(capacities.begin(), capacities.end(), std::greater<unsigned>());
+        unsigned pagesNeeded = 0;
+        unsigned packed = 0;
+        while (packed < objectsOnPages)
+        {
+            packed += capacities[pagesNeeded];
+            ++pagesNeeded;
+        }
+        occupancy.fragmentation = 1.0 - static_cast<double>(pagesNeeded) / occupancy.pagesInUse;
+    }
+    return occupancy;
+}
+
+unsigned SimpleAllocator::freeEmptyPages() {
+    //quarantined blocks would be left pointing into released pages
+    while (pQuarantineHead_ != nullptr)
+    {
+        evictQuarantined();
+    }
+    return releaseEmptyPages(findFreeSlots());
+}
+
+unsigned SimpleAllocator::compact(RELOCATECALLBACK fn, void* pContext) {
+    while (pQuarantineHead_ != nullptr)
+    {
+        evictQuarantined();
+    }
+    std::vector<std::vector<bool>> freeSlots = findFreeSlots();
+
+    //pages with objects in use, densest first
+    std::vector<unsigned> inUse(pageTable_.size(), 0);
+    std::vector<unsigned> order;
+    for (unsigned page = 0; page < pageTable_.size(); ++page)
+    {
+        if (pageTable_[page] == nullptr)
+        {
+            continue;
+        }
+        inUse[page] = static_cast<unsigned>(std::count(freeSlots[page].begin(), freeSlots[page].end(), false));
+        if (inUse[page] > 0)
+        {
+            order.push_back(page);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&inUse](unsigned a, unsigned b) { return inUse[a] > inUse[b]; });
+
+    //fill the densest pages from the sparsest until they meet
+    size_t headerSize = config_.headerBlockInfo.size;
+    size_t headerOffset = headerSize + config_.padBytesSize;
+    std::vector<std::pair<const void*, void*>> moves;
+    size_t dense = 0;
+    size_t sparse = order.size();
+    while (dense + 1 < sparse)
+    {
+        unsigned to = order[dense];
+        unsigned from = order[sparse - 1];
+        if (inUse[to] == pageCapacity_[to])
+        {
+            ++dense;
+            continue;
+        }
+        if (inUse[from] == 0)
+        {
+            --sparse;
+            continue;
+        }
+        unsigned slotTo = static_cast<unsigned>(std::find(freeSlots[to].begin(), freeSlots[to].end(), true) - freeSlots[to].begin());
+        unsigned slotFrom = static_cast<unsigned>(std::find(freeSlots[from].begin(), freeSlots[from].end(), false) - freeSlots[from].begin());
+        char* pOld = pageTable_[from] + firstBlockOffset_ + slotFrom * blockStride_;
+        char* pNew = pageTable_[to] + firstBlockOffset_ + slotTo * blockStride_;
+
+        //the header travels with the object (alloc num, MemBlockInfo*)
+        memcpy(pNew - headerOffset, pOld - headerOffset, headerSize);
+        memcpy(pNew, pOld, stats_.objectSize);
+        auto sampled = sampledBlocks_.find(pOld);
+        if (sampled != sampledBlocks_.end())
+        {
+            sampledBlocks_[pNew] = sampled->second;
+            sampledBlocks_.erase(pOld);
+        }
+        memset(pOld - headerOffset, 0, headerSize);
+        memset(pOld, FREED_PATTERN, stats_.objectSize);
+        moves.emplace_back(pOld, pNew);
+
+        freeSlots[from][slotFrom] = true;
+        freeSlots[to][slotTo] = false;
+        --inUse[from];
+        ++inUse[to];
+    }
+
+    //the free list and stats describe the moved objects before the owner
+    //hears of them, so the callback may allocate from and free to the pool
+    releaseEmptyPages(freeSlots);
+    if (fn != nullptr)
+    {
+        for (const std::pair<const void*, void*>& move : moves)
+        {
+            fn(move.first, move.second, pContext);
+        }
+    }
+    return static_cast<unsigned>(moves.size());
+}
+
+unsigned SimpleAllocator::releaseEmptyPages(const std::vector<std::vector<bool>>& freeSlots) {
+    //sparsest pages are pushed first so allocations fill the densest ones
+    std::vector<unsigned> inUse(pageTable_.size(), 0);
+    std::vector<unsigned> order;
+    for (unsigned page = 0; page < pageTable_.size(); ++page)
+    {
+        if (pageTable_[page] == nullptr)
+        {
+            continue;
+        }
+        inUse[page] = static_cast<unsigned>(std::count(freeSlots[page].begin(), freeSlots[page].end(), false));
+        if (inUse[page] > 0)
+        {
+            order.push_back(page);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&inUse](unsigned a, unsigned b) { return inUse[a] < inUse[b]; });
+
+    //the quarantine is empty, so the free objects are exactly the free
+    //slots of the pages kept (counted, not derived from the old count)
+    pFreeList_ = nullptr;
+    stats_.freeObjects = 0;
+    for (unsigned page : order)
+    {
+        for (unsigned slot = 0; slot < pageCapacity_[page]; ++slot)
+        {
+            if (freeSlots[page][slot])
+            {
+                Node* pBlock = reinterpret_cast<Node*>(pageTable_[page] + firstBlockOffset_ + slot * blockStride_);
+                pBlock->pNext = pFreeList_;
+                pFreeList_ = pBlock;
+                ++stats_.freeObjects;
+            }
+        }
+    }
+
+    //unlink and delete the empty pages
+    unsigned released = 0;
+    Node** ppLink = &pPageList_;
+    while (*ppLink != nullptr)
+    {
+        char* pPage = reinterpret_cast<char*>(*ppLink);
+        unsigned page = pageNumbers_.find(pPage)->second;
+        if (inUse[page] > 0)
+        {
+            ppLink = &(*ppLink)->pNext;
+            continue;
+        }
+        *ppLink = (*ppLink)->pNext;
+        pageNumbers_.erase(pPage);
+        pageTable_[page] = nullptr;
+        delete[] pPage;
+        --stats_.pagesInUse;
+        pageBytes_ -= pageCapacity_[page] * blockStride_ + 8;
+        if (config_.pBudget != nullptr)
+        {
+            config_.pBudget->release(this, pageCapacity_[page] * blockStride_ + 8);
+        }
+        ++released;
+    }
+    return released;
+}
+
+void SimpleAllocator::profileAllocation(const void* pObj, const char* pLabel, const void* pCaller) {
+    if (--profileCountdown_ > 0)
+    {
+        return;
+    }
+    profileCountdown_ = config_.profileSampleRate;
+
+    std::string site;
+    if (pLabel != nullptr)
+    {
+        site = pLabel;
+    }
+    else
+    {
+        char caller[32];
+        snprintf(caller, sizeof(caller), "caller %p", pCaller);
+        site = caller;
+    }
+
+    //each sample stands for profileSampleRate allocations
+    ProfileSite& profile = profileSites_.emplace(site, ProfileSite{0, 0, 0}).first->second;
+    profile.liveBytes += config_.profileSampleRate * stats_.objectSize;
+    profile.peakBytes = std::max(profile.peakBytes, profile.liveBytes);
+    ++profile.samples;
+    sampledBlocks_[pObj] = &profile;
+}
+
+void SimpleAllocator::profileFree(const void* pObj) {
+    auto sampled = sampledBlocks_.find(pObj);
+    if (sampled == sampledBlocks_.end())
+    {
+        return;
+    }
+    sampled->second->liveBytes -= config_.profileSampleRate * stats_.objectSize;
+    sampledBlocks_.erase(sampled);
+}
+
+void SimpleAllocator::dumpProfile(std::ostream& os) const {
+    std::vector<std::pair<std::string, ProfileSite>> sites(profileSites_.begin(), profileSites_.end());
+    std::stable_sort(sites.begin(), sites.end(),
+        [](const std::pair<std::string, ProfileSite>& a, const std::pair<std::string, ProfileSite>& b)
+        {
+            return a.second.liveBytes > b.second.liveBytes;
+        });
+
+    os << "heap profile: 1 in " << config_.profileSampleRate << " allocations of "
+       << stats_.objectSize << " bytes" << std::endl;
+    os << std::setw(12) << "live bytes" << std::setw(12) << "peak bytes"
+       << std::setw(10) << "samples" << "  site" << std::endl;
+    for (const auto& site : sites)
+    {
+        os << std::setw(12) << site.second.liveBytes << std::setw(12) << site.second.peakBytes
+           << std::setw(10) << site.second.samples << "  " << site.first << std::endl;
+    }
+}
+
+bool SimpleAllocator::pageLimitReached() const {
+    if (stats_.pagesInUse >= config_.maxPages)
+    {
+        return true;
+    }
+    size_t pagesize = nextPageCapacity_ * blockStride_ + 8;
+    if (config_.maxBytes > 0 && pageBytes_ + pagesize > config_.maxBytes)
+    {
+        return true;
+    }
+    return config_.pBudget != nullptr && config_.pBudget->getUsed() + pagesize > config_.pBudget->getLimit();
+}
+
+int SimpleAllocator::snapshot(const char* path) const {
+#if HAS_GUARD_PAGES
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when taking snapshot: fork failed.");
+    }
+    if (pid == 0)
+    {
+        //the child sees the pool frozen at the moment of the fork
+        _exit(writeSnapshot(path) ? 0 : 1);
+    }
+    return static_cast<int>(pid);
+#else
+    (void)path;
+    throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when taking snapshot: not supported on this platform.");
+#endif
+}
+
+bool SimpleAllocator::waitSnapshot(int id) {
+#if HAS_GUARD_PAGES
+    int status = 0;
+    if (waitpid(static_cast<pid_t>(id), &status, 0) != static_cast<pid_t>(id))
+    {
+        return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+    (void)id;
+    return false;
+#endif
+}
+
+bool SimpleAllocator::writeSnapshot(const char* path) const {
+#if HAS_GUARD_PAGES
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool ok = true;
+    auto writeBytes = [fd, &ok](const void* pData, size_t size)
+    {
+        const char* p = static_cast<const char*>(pData);
+        while (ok && size > 0)
+        {
+            ssize_t written = write(fd, p, size);
+            if (written <= 0)
+            {
+                ok = false;
+                break;
+            }
+            p += written;
+            size -= static_cast<size_t>(written);
+        }
+    };
+
+    const SimpleAllocatorConfig::HeaderBlockInfo& headerBlockInfo = config_.headerBlockInfo;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.pointerSize = sizeof(void*);
+    header.objectSize = stats_.objectSize;
+    header.firstBlockOffset = firstBlockOffset_;
+    header.blockStride = blockStride_;
+    header.objectsPerPage = config_.objectsPerPage;
+    header.maxPages = config_.maxPages;
+    header.headerType = headerBlockInfo.type;
+    header.headerSize = static_cast<uint32_t>(headerBlockInfo.size);
+    header.alignmentBoundary = config_.alignmentBoundary;
+    header.padBytesSize = config_.padBytesSize;
+    header.isDebug = config_.isDebug ? 1 : 0;
+    header.pageCount = static_cast<uint32_t>(pageNumbers_.size());
+    header.freeObjects = stats_.freeObjects;
+    header.objectsInUse = stats_.objectsInUse;
+    header.mostObjects = stats_.mostObjects;
+    header.allocations = stats_.allocations;
+    header.deallocations = stats_.deallocations;
+    writeBytes(&header, sizeof(header));
+
+    for (const auto& page : pageNumbers_)
+    {
+        SnapshotPage record;
+        record.address = reinterpret_cast<uint64_t>(page.first);
+        record.capacity = pageCapacity_[page.second];
+        record.length = record.capacity * blockStride_ + 8;
+        record.pageNumber = page.second;
+        writeBytes(&record, sizeof(record));
+        writeBytes(page.first, record.length);
+    }
+
+    //free and quarantined blocks, so the analyzer does not depend on patterns
+    const Node* lists[] = {pFreeList_, pQuarantineHead_};
+    for (const Node* pList : lists)
+    {
+        for (const Node* pBlock = pList; pBlock != nullptr; pBlock = pBlock->pNext)
+        {
+            uint64_t address = reinterpret_cast<uint64_t>(pBlock);
+            writeBytes(&address, sizeof(address));
+        }
+    }
+    uint64_t end = 0;
+    writeBytes(&end, sizeof(end));
+
+    //free() clears the MemBlockInfo*, so only blocks in use have one
+    if (headerBlockInfo.type == SimpleAllocatorConfig::EXTERNAL_HEADER)
+    {
+        for (const auto& page : pageNumbers_)
+        {
+            for (unsigned slot = 0; slot < pageCapacity_[page.second]; ++slot)
+            {
+                const char* pBlock = page.first + firstBlockOffset_ + slot * blockStride_;
+                const MemBlockInfo* pInfo = *reinterpret_cast<MemBlockInfo* const*>(pBlock - config_.padBytesSize - headerBlockInfo.size);
+                if (pInfo == nullptr || pInfo->pLabel == nullptr)
+                {
+                    continue;
+                }
+                SnapshotLabel label;
+                label.address = reinterpret_cast<uint64_t>(pBlock);
+                label.length = strlen(pInfo->pLabel);
+                writeBytes(&label, sizeof(label));
+                writeBytes(pInfo->pLabel, label.length);
+            }
+        }
+        writeBytes(&end, sizeof(end));
+    }
+
+    if (close(fd) != 0)
+    {
+        ok = false;
+    }
+    return ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
@@ -12,6 +12,10 @@
 #define SIMPLEALLOCATOR_H
 #include <string>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <map>
+#include <cstdint>
 
 // Defaults for SimpleAllocator construction when client does not specify
 static const int DEFAULT_OBJECTS_PER_PAGE = 4;
@@ -63,6 +67,8 @@ public:
         std::string message_; // Exception message
 };
 
+class MemoryBudget;
+
 /**
  * SimpleAllocator configuration parameters struct
  */
@@ -146,7 +152,17 @@ struct SimpleAllocatorConfig {
         leftAlignBytesSize(0),
         interAlignBytesSize(0),
         padBytesSize(_padBytesSize), 
-        isDebug(_isDebug){}
+        isDebug(_isDebug),
+        useGuardPages(false),
+        guardSampleRate(1),
+        quarantineBytes(0),
+        checkFreedBlocks(false),
+        profileSampleRate(0),
+        pageGrowthFactor(1),
+        maxObjectsPerPage(0),
+        maxBytes(0),
+        pBudget(nullptr),
+        pPoolName(nullptr){}
 
     bool useCPPMemManager; // Use C++ memory manager (operator new) instead of malloc
     unsigned objectsPerPage; // Number of objects per page
@@ -157,6 +173,16 @@ struct SimpleAllocatorConfig {
     unsigned interAlignBytesSize; // num bytes in inter alignment (computed from alignmentBoundary)
     unsigned padBytesSize; // num bytes in padding
     bool isDebug; // True if debug mode is on
+    bool useGuardPages; // Place objects flush against a PROT_NONE guard page (POSIX only)
+    unsigned guardSampleRate; // Guard 1 in N allocations (1 = every allocation)
+    size_t quarantineBytes; // Byte budget of the FIFO quarantine for freed blocks (0 = off)
+    bool checkFreedBlocks; // Verify a free block's pattern before handing it out again
+    unsigned profileSampleRate; // Record 1 in N allocations in the heap profile (0 = off)
+    unsigned pageGrowthFactor; // Each new page holds N times the previous page's objects (1 = fixed)
+    unsigned maxObjectsPerPage; // Cap on the objects of a grown page (0 = objectsPerPage, no growth)
+    size_t maxBytes; // Byte budget for all pages together (0 = only maxPages applies)
+    MemoryBudget* pBudget; // Process-wide budget the pages are charged to (nullptr = none)
+    const char* pPoolName; // Name of the pool in the budget's usage reports
 };
 
 /**
@@ -184,7 +210,9 @@ struct SimpleAllocatorStats { //track what i allocate and free, update state eve
         pagesInUse(0), 
         mostObjects(0), 
         allocations(0), 
-        deallocations(0) {}
+        deallocations(0),
+        guardedObjects(0),
+        quarantinedObjects(0) {}
 #include "SimpleAllocator.h"
     size_t objectSize;      // fixed sizeimpleAllocatorStats::SimpleAllocatorStats(objectSize) of each object
     size_t pageSize;        // fixed size of each pagediscrete math precedence list
@@ -194,6 +222,24 @@ struct SimpleAllocatorStats { //track what i allocate and free, update state eve
     unsigned mostObjects; // most objects in use over lifetime
     unsigned allocations; // total number of allocations over lifetime
     unsigned deallocations; // total number of deallocations over lifetime
+    unsigned guardedObjects; // current number of objects living on guard pages
+    unsigned quarantinedObjects; // current number of freed objects held in quarantine
+};
+
+/**
+ * Per-page occupancy of a SimpleAllocator's pages
+ * - computed on demand by walking the free list, unlike SimpleAllocatorStats
+ */
+struct SimpleAllocatorOccupancy {
+    /**
+     * Constructor
+     * - all params are initialized to 0
+     */
+    SimpleAllocatorOccupancy() : pagesInUse(0), fragmentation(0.0) {}
+
+    std::vector<unsigned> histogram; // histogram[n] = number of pages with n objects in use
+    unsigned pagesInUse; // current number of pages in use
+    double fragmentation; // 1 - (pages needed if packed / pages in use), 0 = fully packed
 };
 
 /**
@@ -220,9 +266,16 @@ public:
      * Callback function for dumping memory blocks
      * @param ptr pointer to memory block
      * @param size size of memory block
-     * TODO: this is unused, for future consideration
      */
-    //typedef void (*DUMPCALLBACK) (const void*, size_t);
+    typedef void (*DUMPCALLBACK) (const void*, size_t);
+
+    /**
+     * Callback function for relocated objects (see compact)
+     * @param pOld old address of the object (still readable)
+     * @param pNew new address of the object
+     * @param pContext client context passed to compact
+     */
+    typedef void (*RELOCATECALLBACK) (const void*, void*, void*);
 
     /**
      * Callback function for validating blocks
@@ -255,7 +308,7 @@ public:
 
     /**
      * Allocate memory
-     * @param label label for memory block (only for EXTERNAL_HEADER)
+     * @param label label for memory block (stored for EXTERNAL_HEADER, also the heap profile site)
      * @return pointer to allocated memory
      */
     void* allocate(const char* pLabel = 0); //default 0
@@ -275,17 +328,94 @@ public:
 
     /**
      * Runs the callback fn on each block that is potentially corrupted
+     * (pad bytes on either side overwritten)
      * @param fn callback function
      * @return number of blocks
-     * TODO this is unimplemented, for future consideration
      */
-    //unsigned dumpCorruptedMemory(DUMPCALLBACK fn) const;
+    unsigned dumpCorruptedMemory(DUMPCALLBACK fn) const;
+
+    /**
+     * Find the first byte in a region that differs from value
+     * - compares 32 (AVX2) or 16 (SSE2) bytes at a time when available,
+     *   otherwise a machine word at a time
+     * @param pRegion start of the region
+     * @param size number of bytes in the region
+     * @param value byte every position is expected to hold
+     * @return pointer to the first mismatching byte, nullptr if none
+     */
+    static const unsigned char* findMismatch(const void* pRegion, size_t size, unsigned char value);
+
+    /**
+     * Check that every byte in a region equals value
+     * @param pRegion start of the region
+     * @param size number of bytes in the region
+     * @param value byte every position is expected to hold
+     * @return true if the whole region holds value
+     */
+    static bool isRegionFilled(const void* pRegion, size_t size, unsigned char value) {
+        return findMismatch(pRegion, size, value) == nullptr;
+    }
 
     /**
      * Free all empty pages
-     * TODO this is unimplemented, for future consideration
+     * - quarantined blocks are moved to the free list first
+     * - handles into released pages become invalid,
+     *   handles into other pages stay valid
+     * @return number of pages released
+     * @throws SimpleAllocatorException if a quarantined block was modified
      */
-    //void freeEmptyPages();
+    unsigned freeEmptyPages();
+
+    /**
+     * Move objects from sparsely occupied pages into densely occupied ones,
+     * then release the pages that became empty
+     * - every object (and its header) is copied to its new block and the
+     *   emptied pages are released, then fn is called once per move so the
+     *   owner can fix every pointer/handle to the object
+     * - by then the pool is consistent again, so fn may allocate and free;
+     *   the old address is only for lookups (its page may be gone)
+     * - guarded objects never move
+     * @param fn relocation callback (called once per moved object)
+     * @param pContext client context passed to fn
+     * @return number of objects moved
+     * @throws SimpleAllocatorException if a quarantined block was modified
+     */
+    unsigned compact(RELOCATECALLBACK fn, void* pContext = nullptr);
+
+    /**
+     * Write the sampled heap profile as flat text, one line per site
+     * sorted by live bytes:  live bytes | peak bytes | samples | site
+     * - a site is the allocation's label, or the caller's address if unlabeled
+     * - every sample stands for profileSampleRate allocations, so bytes
+     *   are estimates scaled by the sample rate
+     * @param os stream to write to
+     */
+    void dumpProfile(std::ostream& os) const;
+
+    /**
+     * Write the pages, config, stats, free list and labels to a file
+     * (format in SimpleAllocatorSnapshot.h, read by the analyzer tool)
+     * - the pool is captured with fork(): the child writes the file from
+     *   its copy-on-write view while the caller carries on allocating
+     * - POSIX only
+     * @param path file to write
+     * @return id of the snapshot, to pass to waitSnapshot
+     * @throws SimpleAllocatorException if the snapshot cannot be started
+     */
+    int snapshot(const char* path) const;
+
+    /**
+     * Wait until a snapshot has been written
+     * @param id id returned by snapshot
+     * @return true if the file was written completely
+     */
+    static bool waitSnapshot(int id);
+
+    /**
+     * Get the per-page occupancy (walks the free list and quarantine)
+     * @return occupancy histogram and fragmentation ratio
+     */
+    SimpleAllocatorOccupancy getOccupancy() const;
 
     /**
      * Set debug state after construction
@@ -317,6 +447,53 @@ public:
      */
     SimpleAllocatorStats getStats() const;
 
+    /**
+     * A compact 32-bit reference to an object: | page number + 1 | slot |
+     * - the slot takes just enough bits for the largest page's objects,
+     *   the page number takes the rest
+     * - 0 is never a valid handle (page numbers are stored + 1)
+     */
+    typedef uint32_t Handle;
+    static const Handle NULL_HANDLE = 0;
+
+    /**
+     * Allocate memory and refer to it by handle
+     * - handles are not available together with guard pages
+     * @param label label for memory block (only for EXTERNAL_HEADER)
+     * @return handle of the allocated memory
+     * @throws SimpleAllocatorException if allocation fails or the page
+     *         number does not fit in the handle
+     */
+    Handle allocateHandle(const char* pLabel = 0);
+
+    /**
+     * Free (deallocate) memory referred to by handle
+     * @param handle handle of the object to deallocate
+     */
+    void freeHandle(Handle handle);
+
+    /**
+     * Get the object a handle refers to
+     * (only shifts, masks and one page table lookup)
+     * @param handle handle of the object (NULL_HANDLE gives nullptr)
+     * @return pointer to the object
+     */
+    void* resolve(Handle handle) const {
+        if (handle == NULL_HANDLE) {
+            return nullptr;
+        }
+        return pageTable_[(handle >> slotBits_) - 1] + firstBlockOffset_ +
+               (handle & ((1u << slotBits_) - 1)) * blockStride_;
+    }
+
+    /**
+     * Get the handle of an object allocated from this allocator
+     * @param pObj pointer to the object (nullptr gives NULL_HANDLE)
+     * @return handle of the object
+     * @throws SimpleAllocatorException if pObj is not a block on a page
+     */
+    Handle handleOf(const void* pObj) const;
+
     void corrupttest(char*block);
 
      
@@ -331,11 +508,127 @@ private:
     SimpleAllocatorStats stats_; // Statistics //update constantly
     Node* pFreeList_; // Head of internal free list
     Node* pPageList_; // Head of internal page list
+    std::vector<char*> pageTable_; // Pages by page number (nullptr once released)
+    std::vector<unsigned> pageCapacity_; // Objects per page by page number
+    unsigned nextPageCapacity_; // Objects the next new page will hold
+    size_t pageBytes_; // Bytes of all pages in use (for maxBytes)
+    std::map<const char*, unsigned> pageNumbers_; // Page number by page address
+    size_t firstBlockOffset_; // Bytes from the page start to its first block
+    size_t blockStride_; // Bytes from one block to the next
+    unsigned slotBits_; // Bits of a handle used for the slot in the page
+
+    /**
+     * A block served from its own mapping, ending right before a guard page
+     */
+    struct GuardedBlock {
+        char* pMapping; // start of the mapping (readable pages + guard page)
+        size_t length;  // total length of the mapping in bytes
+        size_t slack;   // pad bytes between the object and the guard page (alignment only)
+    };
+    std::unordered_map<void*, GuardedBlock> guardedBlocks_; // live guarded blocks
+    unsigned guardCounter_; // allocations seen since construction (for sampling)
+    Node* pQuarantineHead_; // Oldest freed block waiting in quarantine
+    Node* pQuarantineTail_; // Newest freed block waiting in quarantine
+    size_t quarantinedBytes_; // Bytes currently held in quarantine
+
+    /**
+     * Heap profile totals of one allocation site
+     */
+    struct ProfileSite {
+        size_t liveBytes; // estimated bytes still allocated
+        size_t peakBytes; // highest liveBytes seen
+        unsigned samples; // sampled allocations over lifetime
+    };
+    std::map<std::string, ProfileSite> profileSites_; // profile by label/caller
+    std::unordered_map<const void*, ProfileSite*> sampledBlocks_; // live sampled blocks
+    unsigned profileCountdown_; // allocations left until the next sample
                     
     /**
      * Allocate a new page
+     * - it holds nextPageCapacity_ objects, after which nextPageCapacity_
+     *   grows by pageGrowthFactor up to maxObjectsPerPage
+     * @throws SimpleAllocatorException if maxPages or maxBytes is exceeded
      */
     void allocateNewPage();
+
+    /**
+     * Write the snapshot file (runs in the forked child)
+     * - only write(2) is used, no heap allocation, so it is safe after fork
+     * @param path file to write
+     * @return true if the file was written completely
+     */
+    bool writeSnapshot(const char* path) const;
+
+    /**
+     * Check whether another page would exceed maxPages, maxBytes or
+     * (without shrinking other pools) the shared budget
+     * @return true if no new page may be allocated
+     */
+    bool pageLimitReached() const;
+
+    /**
+     * Allocate an object placed at the end of its own page(s),
+     * directly followed by a PROT_NONE guard page
+     * - the object ends flush against the guard page unless an
+     *   alignmentBoundary is configured, in which case the slack left by
+     *   aligning it is filled with PAD_PATTERN and checked on free
+     * @return pointer to the guarded object
+     * @throws SimpleAllocatorException if the mapping fails
+     */
+    void* allocateGuarded();
+
+    /**
+     * Release a guarded object if pObj is one
+     * @param pObj pointer to object
+     * @return true if pObj was a guarded object and has been released
+     */
+    bool freeGuarded(void* pObj);
+
+    /**
+     * Append a freed block (already filled with FREED_PATTERN) to the
+     * quarantine and evict the oldest blocks while over the byte budget
+     * @param pBlock freed block
+     * @throws SimpleAllocatorException if an evicted block was modified
+     */
+    void quarantine(Node* pBlock);
+
+    /**
+     * Move the oldest quarantined block onto the free list after checking
+     * that its FREED_PATTERN is intact
+     * @throws SimpleAllocatorException if the block was written after free
+     */
+    void evictQuarantined();
+
+    /**
+     * Count an allocation towards the heap profile, sampling 1 in
+     * profileSampleRate of them
+     * @param pObj the allocated object
+     * @param pLabel label passed to allocate (or nullptr)
+     * @param pCaller return address of allocate, used if there is no label
+     */
+    void profileAllocation(const void* pObj, const char* pLabel, const void* pCaller);
+
+    /**
+     * Take a freed object out of the heap profile if it was sampled
+     * @param pObj the freed object
+     */
+    void profileFree(const void* pObj);
+
+    /**
+     * Mark the free slots (free list and quarantine) of every page
+     * @return one flag per slot by page number, true if the slot is free
+     *         (empty for page numbers of released pages)
+     */
+    std::vector<std::vector<bool>> findFreeSlots() const;
+
+    /**
+     * Rebuild the free list, densest pages at its head, recount the free
+     * objects and delete every page without objects in use
+     * - the quarantine must be empty
+     * @param freeSlots free slots as returned by findFreeSlots
+     * @return number of pages released
+     */
+    unsigned releaseEmptyPages(const std::vector<std::vector<bool>>& freeSlots);
     //moved allocateNewpage to public
     // The private attributes and methods above are simply examples,
     // feel free to change and add your own private stuff.
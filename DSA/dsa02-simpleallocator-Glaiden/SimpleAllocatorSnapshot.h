@@ -0,0 +1,77 @@
+/**
+ * @file SimpleAllocatorSnapshot.h
+ * @brief Binary format of SimpleAllocator::snapshot files and the
+ *        offline analyzer that reads them
+ *        The file is laid out as:
+ *        | SnapshotHeader |
+ *        | SnapshotPage | page bytes | ... (pageCount times)
+ *        | free block address | ... | 0 |
+ *        | SnapshotLabel | label chars | ... | 0 | (EXTERNAL_HEADER only)
+ *        All values are in the byte order of the machine that wrote it.
+ * @date 19 Oct 2026
+ */
+
+#ifndef SIMPLEALLOCATORSNAPSHOT_H
+#define SIMPLEALLOCATORSNAPSHOT_H
+#include <cstdint>
+#include <iostream>
+
+static const char SNAPSHOT_MAGIC[8] = "SASNAP1"; // identifies a snapshot file
+static const uint32_t SNAPSHOT_VERSION = 1; // bumped when the layout changes
+
+/**
+ * Config, stats and block geometry of the pool, at the start of the file
+ */
+struct SnapshotHeader {
+    char magic[8]; // SNAPSHOT_MAGIC
+    uint32_t version; // SNAPSHOT_VERSION
+    uint32_t pointerSize; // sizeof(void*) of the writer
+    uint64_t objectSize; // object size
+    uint64_t firstBlockOffset; // bytes from a page start to its first block
+    uint64_t blockStride; // bytes from one block to the next
+    uint32_t objectsPerPage; // objects on the first page
+    uint32_t maxPages; // maximum number of pages
+    uint32_t headerType; // SimpleAllocatorConfig::HeaderType
+    uint32_t headerSize; // header size in bytes
+    uint32_t alignmentBoundary; // the boundary to align to
+    uint32_t padBytesSize; // num bytes in padding
+    uint32_t isDebug; // 1 if patterns are being written
+    uint32_t pageCount; // number of SnapshotPage records that follow
+    uint32_t freeObjects; // stats at the time of the snapshot
+    uint32_t objectsInUse;
+    uint32_t mostObjects;
+    uint32_t allocations;
+    uint32_t deallocations;
+    uint32_t reserved; // keeps the header a multiple of 8 bytes
+};
+
+/**
+ * One page, followed by its raw bytes
+ */
+struct SnapshotPage {
+    uint64_t address; // address of the page in the writing process
+    uint64_t length; // number of page bytes that follow
+    uint32_t pageNumber; // page number (as used by handles)
+    uint32_t capacity; // objects on the page
+};
+
+/**
+ * The label of a block in use, followed by its characters (no NUL)
+ */
+struct SnapshotLabel {
+    uint64_t address; // address of the block in the writing process
+    uint64_t length; // number of characters that follow
+};
+
+/**
+ * Read a snapshot file and report on it as text:
+ * occupancy, corrupted blocks, labels of blocks in use and leak candidates
+ * (the longest-lived blocks, when headers record allocation numbers)
+ * @param path snapshot file written by SimpleAllocator::snapshot
+ * @param os stream to write the report to
+ * @throws SimpleAllocatorException if the file cannot be read, is not a snapshot
+ *         or is corrupt (lengths or geometry that do not fit the file)
+ */
+void analyzeSnapshot(const char* path, std::ostream& os);
+
+#endif // SIMPLEALLOCATORSNAPSHOT_H
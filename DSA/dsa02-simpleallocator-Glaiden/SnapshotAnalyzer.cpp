@@ -0,0 +1,278 @@
+#include "SimpleAllocatorSnapshot.h"
+#include "SimpleAllocator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * A page read back from a snapshot
+ */
+struct LoadedPage {
+    SnapshotPage record; // page number, capacity, original address
+    std::vector<char> bytes; // raw page bytes
+};
+
+/**
+ * Read exactly size bytes or fail
+ * @param in snapshot stream
+ * @param pData where to read to
+ * @param size number of bytes
+ * @throws SimpleAllocatorException if the file ends early
+ */
+static void readBytes(std::ifstream& in, void* pData, size_t size) {
+    if (!in.read(static_cast<char*>(pData), static_cast<std::streamsize>(size)))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "ERROR when reading snapshot: file is truncated.");
+    }
+}
+
+/**
+ * Fail on a corrupt snapshot
+ * @param what what is wrong with it
+ * @throws SimpleAllocatorException always
+ */
+static void corrupt(const char* what) {
+    throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, std::string("ERROR when reading snapshot: corrupt snapshot, ") + what + ".");
+}
+
+/**
+ * Number of bytes between the read position and the end of the file
+ * @param in snapshot stream
+ * @param fileSize size of the file
+ * @return bytes left to read
+ */
+static uint64_t bytesLeft(std::ifstream& in, uint64_t fileSize) {
+    uint64_t position = static_cast<uint64_t>(in.tellg());
+    return position < fileSize ? fileSize - position : 0;
+}
+
+/**
+ * Check the block geometry of the header, so blocks and their headers and
+ * pad bytes can be read at the recorded offsets
+ * @param header snapshot header
+ * @throws SimpleAllocatorException if it cannot describe a pool
+ */
+static void checkGeometry(const SnapshotHeader& header) {
+    //basic and extended headers are read for their allocation number
+    uint32_t minHeaderSize[] = {0, sizeof(unsigned) + 1, sizeof(unsigned) + sizeof(unsigned short) + 1, sizeof(void*)};
+    if (header.headerType > SimpleAllocatorConfig::EXTERNAL_HEADER || header.headerSize < minHeaderSize[header.headerType])
+    {
+        corrupt("unknown header type or header too small");
+    }
+    if (header.objectSize == 0 || header.isDebug > 1 || header.pageCount > header.maxPages)
+    {
+        corrupt("bad object size, debug flag or page count");
+    }
+    uint64_t before = static_cast<uint64_t>(header.headerSize) + header.padBytesSize;
+    uint64_t around = before + header.padBytesSize;
+    if (header.objectSize > UINT32_MAX || header.firstBlockOffset < before ||
+        header.blockStride < around + header.objectSize)
+    {
+        corrupt("blocks overlap their headers or each other");
+    }
+}
+
+/**
+ * Check a page record against the header geometry and the rest of the file
+ * @param header snapshot header
+ * @param record page record
+ * @param left bytes of the file after the record
+ * @throws SimpleAllocatorException if its blocks do not fit in its bytes
+ */
+static void checkPage(const SnapshotHeader& header, const SnapshotPage& record, uint64_t left) {
+    if (record.length > left)
+    {
+        corrupt("page is longer than the rest of the file");
+    }
+    if (record.capacity == 0)
+    {
+        return;
+    }
+    //the last block and its trailing pad bytes end inside the page
+    uint64_t tail = header.objectSize + header.padBytesSize;
+    if (record.length < header.firstBlockOffset || record.length - header.firstBlockOffset < tail ||
+        (record.length - header.firstBlockOffset - tail) / header.blockStride < record.capacity - 1)
+    {
+        corrupt("page capacity does not fit in its bytes");
+    }
+}
+
+void analyzeSnapshot(const char* path, std::ostream& os) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_NO_MEMORY, "ERROR when reading snapshot: open failed.");
+    }
+    uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+    SnapshotHeader header;
+    readBytes(in, &header, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION ||
+        header.pointerSize != sizeof(void*))
+    {
+        throw SimpleAllocatorException(SimpleAllocatorException::E_BAD_BOUNDARY, "ERROR when reading snapshot: not a compatible SimpleAllocator snapshot.");
+    }
+
+    //nothing read from the file is trusted to size a buffer or index a page
+    checkGeometry(header);
+    if (header.pageCount > bytesLeft(in, fileSize) / sizeof(SnapshotPage))
+    {
+        corrupt("more pages than the file holds");
+    }
+    std::vector<LoadedPage> pages(header.pageCount);
+    for (LoadedPage& page : pages)
+    {
+        readBytes(in, &page.record, sizeof(page.record));
+        checkPage(header, page.record, bytesLeft(in, fileSize));
+        page.bytes.resize(page.record.length);
+        readBytes(in, page.bytes.data(), page.bytes.size());
+    }
+    std::sort(pages.begin(), pages.end(), [](const LoadedPage& a, const LoadedPage& b) {
+        return a.record.pageNumber < b.record.pageNumber;
+    });
+
+    std::set<uint64_t> freeBlocks;
+    uint64_t address;
+    readBytes(in, &address, sizeof(address));
+    while (address != 0)
+    {
+        freeBlocks.insert(address);
+        readBytes(in, &address, sizeof(address));
+    }
+
+    std::map<uint64_t, std::string> labels;
+    if (header.headerType == SimpleAllocatorConfig::EXTERNAL_HEADER)
+    {
+        SnapshotLabel label;
+        readBytes(in, &label.address, sizeof(label.address));
+        while (label.address != 0)
+        {
+            readBytes(in, &label.length, sizeof(label.length));
+            if (label.length > bytesLeft(in, fileSize))
+            {
+                corrupt("label is longer than the rest of the file");
+            }
+            std::string text(label.length, '\0');
+            readBytes(in, &text[0], label.length);
+            labels[label.address] = text;
+            readBytes(in, &label.address, sizeof(label.address));
+        }
+    }
+
+    const char* headerNames[] = {"NONE", "BASIC", "EXTENDED", "EXTERNAL"};
+    os << "snapshot of a pool of " << header.objectSize << "-byte objects"
+       << ", headerType:" << headerNames[header.headerType]
+       << ", padBytes:" << header.padBytesSize
+       << ", debug:" << header.isDebug << std::endl;
+    os << "objectsInUse: " << header.objectsInUse << ", freeObjects: " << header.freeObjects
+       << ", allocations: " << header.allocations << ", frees: " << header.deallocations << std::endl;
+
+    //occupancy
+    os << std::endl << "occupancy (" << pages.size() << " pages):" << std::endl;
+    unsigned objectsOnPages = 0;
+    unsigned slotsOnPages = 0;
+    for (const LoadedPage& page : pages)
+    {
+        unsigned inUse = 0;
+        for (unsigned slot = 0; slot < page.record.capacity; ++slot)
+        {
+            uint64_t block = page.record.address + header.firstBlockOffset + slot * header.blockStride;
+            inUse += freeBlocks.count(block) == 0 ? 1 : 0;
+        }
+        os << "  page " << page.record.pageNumber << ": " << inUse << "/" << page.record.capacity << " in use" << std::endl;
+        objectsOnPages += inUse;
+        slotsOnPages += page.record.capacity;
+    }
+    if (slotsOnPages > 0)
+    {
+        char utilization[16];
+        snprintf(utilization, sizeof(utilization), "%.2f", static_cast<double>(objectsOnPages) / slotsOnPages);
+        os << "  utilization: " << utilization << std::endl;
+    }
+
+    //corruption: pad bytes around every block, freed pattern of free blocks
+    os << std::endl << "corruption:" << std::endl;
+    unsigned corrupted = 0;
+    std::vector<std::pair<unsigned, unsigned>> allocNums; // alloc num, page number
+    for (const LoadedPage& page : pages)
+    {
+        for (unsigned slot = 0; slot < page.record.capacity; ++slot)
+        {
+            size_t offset = header.firstBlockOffset + slot * header.blockStride;
+            const char* pBlock = page.bytes.data() + offset;
+            bool isFree = freeBlocks.count(page.record.address + offset) != 0;
+            if (!SimpleAllocator::isRegionFilled(pBlock - header.padBytesSize, header.padBytesSize, SimpleAllocator::PAD_PATTERN))
+            {
+                os << "  page " << page.record.pageNumber << " slot " << slot << ": pad bytes before block overwritten" << std::endl;
+                ++corrupted;
+            }
+            if (!SimpleAllocator::isRegionFilled(pBlock + header.objectSize, header.padBytesSize, SimpleAllocator::PAD_PATTERN))
+            {
+                os << "  page " << page.record.pageNumber << " slot " << slot << ": pad bytes after block overwritten" << std::endl;
+                ++corrupted;
+            }
+            if (isFree && header.isDebug && header.objectSize > sizeof(void*))
+            {
+                const char* pAfterLink = pBlock + sizeof(void*);
+                size_t size = header.objectSize - sizeof(void*);
+                if (!SimpleAllocator::isRegionFilled(pAfterLink, size, SimpleAllocator::FREED_PATTERN) &&
+                    !SimpleAllocator::isRegionFilled(pAfterLink, size, SimpleAllocator::UNALLOCATED_PATTERN))
+                {
+                    os << "  page " << page.record.pageNumber << " slot " << slot << ": free block written after free" << std::endl;
+                    ++corrupted;
+                }
+            }
+
+            //basic and extended headers record the allocation number
+            if (!isFree && header.headerType == SimpleAllocatorConfig::BASIC_HEADER)
+            {
+                unsigned allocNum;
+                memcpy(&allocNum, pBlock - header.padBytesSize - header.headerSize, sizeof(allocNum));
+                allocNums.push_back(std::make_pair(allocNum, page.record.pageNumber));
+            }
+            else if (!isFree && header.headerType == SimpleAllocatorConfig::EXTENDED_HEADER)
+            {
+                unsigned allocNum;
+                memcpy(&allocNum, pBlock - header.padBytesSize - 5, sizeof(allocNum));
+                allocNums.push_back(std::make_pair(allocNum, page.record.pageNumber));
+            }
+        }
+    }
+    if (corrupted == 0)
+    {
+        os << "  none" << std::endl;
+    }
+
+    //labels of blocks in use
+    os << std::endl << "labels:" << std::endl;
+    std::map<std::string, unsigned> labelCounts;
+    for (const auto& label : labels)
+    {
+        ++labelCounts[label.second];
+    }
+    for (const auto& label : labelCounts)
+    {
+        os << "  " << label.first << ": " << label.second << " in use" << std::endl;
+    }
+    if (labelCounts.empty())
+    {
+        os << "  none recorded" << std::endl;
+    }
+
+    //leak candidates: the oldest allocations still in use
+    os << std::endl << "leak candidates:" << std::endl;
+    std::sort(allocNums.begin(), allocNums.end());
+    for (size_t i = 0; i < allocNums.size() && i < 5; ++i)
+    {
+        os << "  alloc #" << allocNums[i].first << " on page " << allocNums[i].second << std::endl;
+    }
+    if (allocNums.empty())
+    {
+        os << "  none (headers record no allocation numbers)" << std::endl;
+    }
+}
@@ -0,0 +1,24 @@
+/**
+ * @file analyzer.cpp
+ * @brief Command-line analyzer for SimpleAllocator::snapshot files
+ *        Usage: ./analyzer <snapshot-file>
+ * @date 19 Oct 2026
+ */
+
+#include "SimpleAllocatorSnapshot.h"
+#include "SimpleAllocator.h"
+#include <iostream>
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <snapshot-file>" << std::endl;
+    return 2;
+  }
+  try {
+    analyzeSnapshot(argv[1], std::cout);
+  } catch (const SimpleAllocatorException &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -7,7 +7,12 @@
  */
 
 #include "SimpleAllocator.h"
+#include "MappedSimpleAllocator.h"
+#include "EpochReclaimer.h"
+#include "MemoryBudget.h"
+#include "SimpleAllocatorSnapshot.h"
 #include "prng.h"
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -15,6 +20,14 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 using std::cout;
 using std::endl;
@@ -516,6 +529,1072 @@ void corruptionTest(SimpleAllocator* allocator) {
   }
 }
 
+/**
+ * Allocate objects with guard pages sampled on some of them and check that
+ * each guarded object ends exactly where its PROT_NONE guard page starts.
+ * Writing past the end of such an object would fault right away, so the
+ * test only writes within bounds.
+ *
+ * @param allocator an existing allocator with guard pages enabled
+ * @param numObjsToAllocate number of objects to allocate
+ */
+void guardPageTest(SimpleAllocator* allocator, unsigned numObjsToAllocate) {
+  try {
+    // print a title of the test
+    cout << "Running guardPageTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    cout << "guardPages:" << allocator->getConfig().useGuardPages;
+    cout << ", guardSampleRate:" << allocator->getConfig().guardSampleRate;
+    cout << endl << endl;
+
+    // init a ptrs array
+    void *ptrs[numObjsToAllocate];
+
+    // allocate memory and fill each object up to its last byte
+    auto objSize = allocator->getStats().objectSize;
+    for (unsigned i = 0; i < numObjsToAllocate; i++) {
+      ptrs[i] = allocator->allocate();
+      memset(ptrs[i], 0x11, objSize);
+    }
+
+    // print the stats, including how many objects are guarded
+    cout << "After " << numObjsToAllocate << " allocations..." << endl;
+    printStats(allocator);
+    cout << "guardedObjects: " << allocator->getStats().guardedObjects << endl;
+
+    // every guardSampleRate-th object is guarded, and a guarded object ends
+    // right at a page boundary (the guard page)
+    // - pool objects are skipped as they may end on a boundary by chance
+    long pageBytes = sysconf(_SC_PAGESIZE);
+    unsigned rate = allocator->getConfig().guardSampleRate;
+    for (unsigned i = rate - 1; i < numObjsToAllocate; i += rate) {
+      uintptr_t end = reinterpret_cast<uintptr_t>(ptrs[i]) + objSize;
+      cout << "Object " << i << " ends on a guard page: "
+           << ((end % pageBytes == 0) ? "yes" : "no") << endl;
+    }
+    cout << endl;
+
+    // free everything, guarded or not
+    for (unsigned i = 0; i < numObjsToAllocate; i++) {
+      allocator->free(ptrs[i]);
+    }
+
+    cout << "After " << numObjsToAllocate << " frees..." << endl;
+    printStats(allocator);
+    cout << "guardedObjects: " << allocator->getStats().guardedObjects << endl;
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Free some objects into a quarantine, then fabricate a use-after-free by
+ * writing through a stale pointer. The stale write is expected to be
+ * reported when the block leaves the quarantine.
+ *
+ * @param allocator an existing allocator with a quarantine budget
+ */
+void quarantineTest(SimpleAllocator* allocator) {
+  try {
+    // print a title of the test
+    cout << "Running quarantineTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    cout << "quarantineBytes:" << allocator->getConfig().quarantineBytes;
+    cout << endl << endl;
+
+    // num objects to allocate
+    auto numObjsToAllocate = 6;
+
+    // init a ptrs array
+    void *ptrs[numObjsToAllocate];
+
+    // allocate memory into the ptrs array
+    for (auto i = 0; i < numObjsToAllocate; i++) {
+      ptrs[i] = allocator->allocate();
+    }
+
+    // free a couple of objects, they should wait in quarantine
+    allocator->free(ptrs[0]);
+    allocator->free(ptrs[1]);
+    cout << "After 2 frees..." << endl;
+    printStats(allocator);
+    cout << "quarantinedObjects: " << allocator->getStats().quarantinedObjects
+         << endl;
+    dumpPages(allocator, 32);
+
+    // fabricate a use-after-free through the stale pointer of the 1st object
+    // - skip the bytes holding the quarantine link
+    auto pByte = static_cast<unsigned char*>(ptrs[0]) + sizeof(void*);
+    *pByte = 0x42;
+
+    // keep freeing, the stale block gets evicted and checked
+    for (auto i = 2; i < numObjsToAllocate; i++) {
+      allocator->free(ptrs[i]);
+      cout << "After freeing object " << i << "..." << endl;
+      printStats(allocator);
+      cout << "quarantinedObjects: " << allocator->getStats().quarantinedObjects
+           << endl;
+    }
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Fabricate corruption in the pad bytes of some blocks and in a freed block,
+ * then let the allocator's validation find them:
+ * 1. dumpCorruptedMemory should report the blocks with overwritten pads
+ * 2. allocate should report the freed block written to after free
+ *
+ * @param allocator an existing allocator with pad bytes and freed block checks
+ */
+void validationTest(SimpleAllocator* allocator) {
+  try {
+    // print a title of the test
+    cout << "Running validationTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    cout << "checkFreedBlocks:" << allocator->getConfig().checkFreedBlocks;
+    cout << endl << endl;
+
+    // num objects to allocate
+    auto numObjsToAllocate = 4;
+
+    // init a ptrs array
+    void *ptrs[numObjsToAllocate];
+
+    // allocate memory into the ptrs array
+    for (auto i = 0; i < numObjsToAllocate; i++) {
+      ptrs[i] = allocator->allocate();
+    }
+
+    // overrun the 1st object into its right pad and underrun the 3rd one
+    auto padBytes = allocator->getConfig().padBytesSize;
+    auto objSize = allocator->getStats().objectSize;
+    static_cast<unsigned char*>(ptrs[0])[objSize + padBytes - 1] = 0xFF;
+    static_cast<unsigned char*>(ptrs[2])[-1] = 0xFF;
+
+    // validate the pages
+    cout << "Validating after some corruption..." << endl;
+    unsigned corrupted = allocator->dumpCorruptedMemory(validateCallback);
+    cout << "Corrupted blocks: " << corrupted << endl << endl;
+
+    // free an intact object and write through the stale pointer
+    allocator->free(ptrs[1]);
+    static_cast<unsigned char*>(ptrs[1])[objSize - 1] = 0x42;
+    cout << "After 1 free and a write through the stale pointer..." << endl;
+    printStats(allocator);
+
+    // the freed block is the next to be handed out
+    allocator->allocate();
+
+    // print stats if no exception from above
+    // - the expected behavior is that the above will throw an exception
+    cout << "After reallocating the freed block..." << endl;
+    printStats(allocator);
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Hand an object from one process to another through a shared pool
+ * 1. create a shared pool and allocate a message in it
+ * 2. fork a child that attaches to the pool by name (a separate mapping)
+ * 3. the child reads the message through its offset and frees it
+ * 4. the parent sees the free in the shared stats
+ *
+ * @param name name of the shared memory segment
+ */
+void sharedPoolTest(const char* name) {
+  try {
+    // print a title of the test
+    cout << "Running sharedPoolTest..." << endl << endl;
+
+    // create the shared pool
+    SimpleAllocatorConfig config(false, 4, 2,
+            SimpleAllocatorConfig::HeaderBlockInfo(), 0, 2, true);
+    MappedSimpleAllocator pool(name, sizeof(Person), config);
+
+    // allocate and fill a message
+    Person* message = static_cast<Person*>(pool.allocate());
+    *message = PEOPLE[0];
+    MappedOffset offset = pool.toOffset(message);
+
+    SimpleAllocatorStats stats = pool.getStats();
+    cout << "Parent allocated a message..." << endl;
+    cout << "pagesInUse: " << stats.pagesInUse;
+    cout << ", objectsInUse: " << stats.objectsInUse;
+    cout << ", freeObjects: " << stats.freeObjects << endl << endl;
+    cout.flush();
+
+    // the child attaches by name, so its mapping is at a different address
+    pid_t pid = fork();
+    if (pid == 0) {
+      try {
+        MappedSimpleAllocator childPool(name);
+        Person* received = static_cast<Person*>(childPool.fromOffset(offset));
+        cout << "Child received: " << received->firstName << " "
+             << received->lastName << ", " << received->years << " years"
+             << endl;
+        childPool.free(received);
+        cout << "Child freed the message" << endl << endl;
+      } catch (const SimpleAllocatorException &e) {
+        cout << e.what() << endl;
+      }
+      cout.flush();
+      _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+
+    stats = pool.getStats();
+    cout << "Parent after the child is done..." << endl;
+    cout << "pagesInUse: " << stats.pagesInUse;
+    cout << ", objectsInUse: " << stats.objectsInUse;
+    cout << ", freeObjects: " << stats.freeObjects;
+    cout << ", allocations: " << stats.allocations;
+    cout << ", frees: " << stats.deallocations << endl;
+
+    MappedSimpleAllocator::remove(name);
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    MappedSimpleAllocator::remove(name);
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Objects smaller than a free list link, with odd-sized pad bytes
+ * 1. fill every page of a shared pool with 4-byte objects and 3 pad bytes
+ * 2. check every object is aligned and keeps its value
+ * 3. free them all (checking the pad bytes) and allocate them again
+ * 4. the same with objects aligned to a 64-byte boundary
+ *
+ * @param name name of the shared memory segment
+ */
+void smallObjectPoolTest(const char* name) {
+  try {
+    // print a title of the test
+    cout << "Running smallObjectPoolTest..." << endl << endl;
+
+    const unsigned boundaries[] = {0, 64};
+    for (unsigned boundary : boundaries) {
+      SimpleAllocatorConfig config(false, 4, 3,
+              SimpleAllocatorConfig::HeaderBlockInfo(), boundary, 3, true);
+      MappedSimpleAllocator pool(name, sizeof(unsigned), config);
+      size_t alignment = boundary > 0 ? boundary : alignof(std::max_align_t);
+      cout << "objectSize: " << sizeof(unsigned) << ", padBytes: 3"
+           << ", alignment: " << (boundary > 0 ? "64" : "max_align_t") << endl;
+
+      // fill every page, each object holding its own index
+      std::vector<unsigned*> objects;
+      bool aligned = true;
+      for (unsigned i = 0; i < 12; i++) {
+        unsigned* object = static_cast<unsigned*>(pool.allocate());
+        aligned = aligned && reinterpret_cast<uintptr_t>(object) % alignment == 0;
+        *object = i;
+        objects.push_back(object);
+      }
+      bool intact = true;
+      for (unsigned i = 0; i < objects.size(); i++)
+        intact = intact && *objects[i] == i;
+      SimpleAllocatorStats stats = pool.getStats();
+      cout << "Allocated " << objects.size() << " objects, aligned: "
+           << (aligned ? "yes" : "no") << ", values intact: "
+           << (intact ? "yes" : "no") << endl;
+      cout << "pagesInUse: " << stats.pagesInUse;
+      cout << ", objectsInUse: " << stats.objectsInUse;
+      cout << ", freeObjects: " << stats.freeObjects << endl;
+
+      // the links of the freed objects must not touch the pad bytes
+      for (unsigned* object : objects)
+        pool.free(object);
+      for (unsigned i = 0; i < objects.size(); i++)
+        objects[i] = static_cast<unsigned*>(pool.allocate());
+      for (unsigned* object : objects)
+        pool.free(object);
+      stats = pool.getStats();
+      cout << "Freed, reallocated and freed them again..." << endl;
+      cout << "pagesInUse: " << stats.pagesInUse;
+      cout << ", objectsInUse: " << stats.objectsInUse;
+      cout << ", freeObjects: " << stats.freeObjects;
+      cout << ", allocations: " << stats.allocations;
+      cout << ", frees: " << stats.deallocations << endl << endl;
+
+      MappedSimpleAllocator::remove(name);
+    }
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    MappedSimpleAllocator::remove(name);
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * An entry of a linked list that lives in a persistent pool
+ * - the link is an offset so that it survives a remap at another address
+ */
+struct PersistentEntry {
+  MappedOffset next;
+  Person person;
+};
+
+/**
+ * Build a linked list in a file-backed pool, close the pool as if the
+ * process restarted, then reopen the file and walk the list again
+ * without rebuilding it.
+ * A second open while the pool is open, and a reopen of the file after it
+ * has been truncated, must both be refused.
+ *
+ * @param path path of the pool file
+ */
+void persistentPoolTest(const char* path) {
+  try {
+    // print a title of the test
+    cout << "Running persistentPoolTest..." << endl << endl;
+
+    // build a small list in a new pool file
+    {
+      SimpleAllocatorConfig config(false, 4, 2,
+              SimpleAllocatorConfig::HeaderBlockInfo(), 0, 0, true);
+      MappedSimpleAllocator pool(path, sizeof(PersistentEntry), config,
+                                 MappedSimpleAllocator::FILE);
+      MappedOffset head = 0;
+      for (unsigned i = 0; i < 5; i++) {
+        PersistentEntry* entry =
+            static_cast<PersistentEntry*>(pool.allocate());
+        entry->person = PEOPLE[i];
+        entry->next = head;
+        head = pool.toOffset(entry);
+      }
+      pool.setRoot(pool.fromOffset(head));
+
+      // the file is locked while the pool is open
+      try {
+        MappedSimpleAllocator second(path, MappedSimpleAllocator::FILE);
+        cout << "Second open while in use: accepted" << endl;
+      } catch (const SimpleAllocatorException &e) {
+        cout << "Second open while in use: refused" << endl;
+      }
+      cout << "Built 5 entries, closing the pool..." << endl << endl;
+    }
+
+    // reopen and walk the list from the recorded root
+    size_t pageSize = 0;
+    {
+      MappedSimpleAllocator pool(path, MappedSimpleAllocator::FILE);
+      SimpleAllocatorStats stats = pool.getStats();
+      cout << "Reopened pool..." << endl;
+      cout << "pagesInUse: " << stats.pagesInUse;
+      cout << ", objectsInUse: " << stats.objectsInUse;
+      cout << ", freeObjects: " << stats.freeObjects << endl;
+      for (PersistentEntry* entry = static_cast<PersistentEntry*>(pool.getRoot());
+           entry != nullptr;
+           entry = static_cast<PersistentEntry*>(pool.fromOffset(entry->next))) {
+        cout << "  " << entry->person.firstName << " "
+             << entry->person.lastName << endl;
+      }
+      pageSize = stats.pageSize;
+    }
+    cout << endl;
+
+    // cut the last page off the file, the header no longer matches it
+    struct stat info;
+    if (stat(path, &info) != 0 ||
+        truncate(path, info.st_size - static_cast<off_t>(pageSize)) != 0) {
+      cout << "Could not truncate the pool file." << endl;
+    }
+    try {
+      MappedSimpleAllocator pool(path, MappedSimpleAllocator::FILE);
+      cout << "Reopen of a truncated file: accepted" << endl;
+    } catch (const SimpleAllocatorException &e) {
+      cout << "Reopen of a truncated file: refused" << endl;
+    }
+
+    MappedSimpleAllocator::remove(path, MappedSimpleAllocator::FILE);
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    MappedSimpleAllocator::remove(path, MappedSimpleAllocator::FILE);
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Allocate objects by handle instead of pointer
+ * 1. allocate some objects as 32-bit handles spread over a few pages
+ * 2. resolve the handles to fill and read the objects
+ * 3. check that handleOf gives back the same handles
+ * 4. free the objects by handle
+ *
+ * @param allocator an existing allocator to use
+ * @param numObjsToAllocate number of objects to allocate
+ */
+void handleTest(SimpleAllocator* allocator, unsigned numObjsToAllocate) {
+  try {
+    // print a title of the test
+    cout << "Running handleTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    cout << "sizeof(Handle) = " << sizeof(SimpleAllocator::Handle) << endl;
+    cout << endl;
+
+    // init a handles array
+    SimpleAllocator::Handle handles[numObjsToAllocate];
+
+    // allocate by handle and fill each object through its handle
+    for (unsigned i = 0; i < numObjsToAllocate; i++) {
+      handles[i] = allocator->allocateHandle();
+      Person* person = static_cast<Person*>(allocator->resolve(handles[i]));
+      *person = PEOPLE[i];
+    }
+
+    // print the handles and what they resolve to
+    cout << "After " << numObjsToAllocate << " allocations..." << endl;
+    printStats(allocator);
+    for (unsigned i = 0; i < numObjsToAllocate; i++) {
+      const Person* person =
+          static_cast<const Person*>(allocator->resolve(handles[i]));
+      printf("Handle 0x%08X -> %s %s", handles[i], person->firstName,
+             person->lastName);
+      printf(" (handleOf: %s)\n",
+             allocator->handleOf(person) == handles[i] ? "same" : "different");
+    }
+    cout << endl;
+
+    // free by handle
+    for (unsigned i = 0; i < numObjsToAllocate; i++) {
+      allocator->freeHandle(handles[i]);
+    }
+    cout << "After " << numObjsToAllocate << " frees..." << endl;
+    printStats(allocator);
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Epoch-based reclamation test of the allocator
+ * 1. show that a reader inside a critical section keeps a retired object alive
+ * 2. let a writer replace a shared object while readers keep reading it
+ * 3. check no reader ever saw a freed object and everything retired is freed
+ * 4. check a batch with a corrupted block frees the rest, and only once
+ * @param allocator an existing allocator to use
+ * @param numUpdates number of times the writer replaces the shared object
+ */
+void epochTest(SimpleAllocator* allocator, unsigned numUpdates) {
+  try {
+    // print a title of the test
+    cout << "Running epochTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    cout << endl;
+
+    EpochReclaimer reclaimer(allocator, 8);
+
+    // a reader that entered before the retire pins the object
+    unsigned slot = reclaimer.registerReader();
+    reclaimer.enter(slot);
+    Person* person = static_cast<Person*>(reclaimer.allocate());
+    *person = PEOPLE[0];
+    reclaimer.retire(person);
+    cout << "Retired " << person->firstName << " " << person->lastName
+         << " while a reader is active" << endl;
+    for (unsigned i = 0; i < 2; i++) {
+      unsigned freed = reclaimer.reclaim();
+      cout << "reclaim: freed " << freed << ", pending "
+           << reclaimer.pending() << ", epoch " << reclaimer.epoch() << endl;
+    }
+    cout << "Reader still sees " << person->firstName << " "
+         << person->lastName << endl;
+    reclaimer.leave(slot);
+    reclaimer.unregisterReader(slot);
+    unsigned freed = reclaimer.reclaim();
+    cout << "After leave, reclaim: freed " << freed << ", pending "
+         << reclaimer.pending() << ", epoch " << reclaimer.epoch() << endl;
+    cout << endl;
+
+    // readers keep reading the shared object while the writer replaces it
+    std::atomic<Person*> shared(static_cast<Person*>(reclaimer.allocate()));
+    *shared.load() = PEOPLE[0];
+    std::atomic<bool> done(false);
+    std::atomic<unsigned> badReads(0);
+    std::thread readers[2];
+    for (unsigned r = 0; r < 2; r++) {
+      unsigned readerSlot = reclaimer.registerReader();
+      readers[r] = std::thread([&, readerSlot]() {
+        while (!done.load()) {
+          EpochReclaimer::Guard guard(reclaimer, readerSlot);
+          const Person* current = shared.load();
+          // a freed object would be filled with the freed pattern
+          if (current->firstName[0] < 'A' || current->firstName[0] > 'Z')
+            ++badReads;
+        }
+        reclaimer.unregisterReader(readerSlot);
+      });
+    }
+    for (unsigned i = 1; i <= numUpdates; i++) {
+      Person* next = static_cast<Person*>(reclaimer.allocate());
+      *next = PEOPLE[i % 10];
+      reclaimer.retire(shared.exchange(next));
+    }
+    done = true;
+    for (unsigned r = 0; r < 2; r++)
+      readers[r].join();
+
+    // with no readers left every retired object is freed within 3 epochs
+    reclaimer.retire(shared.exchange(nullptr));
+    while (reclaimer.pending() > 0)
+      reclaimer.reclaim();
+
+    // a block overrun after it was retired cannot be freed: it is dropped,
+    // the rest of its batch is still freed and nothing is freed twice
+    Person* intact = static_cast<Person*>(reclaimer.allocate());
+    Person* overrun = static_cast<Person*>(reclaimer.allocate());
+    reclaimer.retire(intact);
+    reclaimer.retire(overrun);
+    char* pad = reinterpret_cast<char*>(overrun) + allocator->getStats().objectSize;
+    char saved = *pad;
+    *pad = 0;
+    try {
+      while (reclaimer.pending() > 0)
+        reclaimer.reclaim();
+    } catch (const SimpleAllocatorException &e) {
+      cout << "reclaim with an overrun block: " << e.what() << endl;
+    }
+    cout << "pending: " << reclaimer.pending() << ", next reclaim freed "
+         << reclaimer.reclaim() << endl;
+    *pad = saved;
+    allocator->free(overrun);
+
+    SimpleAllocatorStats stats = allocator->getStats();
+    cout << "After " << numUpdates << " updates with 2 readers..." << endl;
+    cout << "badReads: " << badReads.load();
+    cout << ", objectsInUse: " << stats.objectsInUse;
+    cout << ", allocations: " << stats.allocations;
+    cout << ", frees: " << stats.deallocations << endl;
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Relocation callback for compactTest
+ * - the context is the test's table of objects, the moved entry is updated
+ * @param pOld old address of the object
+ * @param pNew new address of the object
+ * @param pContext pointer to the std::vector<Person*> of objects
+ */
+void relocatePerson(const void* pOld, void* pNew, void* pContext) {
+  std::vector<Person*>* objects = static_cast<std::vector<Person*>*>(pContext);
+  for (Person*& person : *objects) {
+    if (person == pOld)
+      person = static_cast<Person*>(pNew);
+  }
+}
+
+/**
+ * Print the per-page occupancy of the allocator
+ * @param allocator allocator to print the occupancy of
+ */
+void printOccupancy(const SimpleAllocator *allocator) {
+  SimpleAllocatorOccupancy occupancy = allocator->getOccupancy();
+  cout << "pagesInUse: " << occupancy.pagesInUse << ", histogram:";
+  for (unsigned i = 0; i < occupancy.histogram.size(); i++)
+    cout << " " << i << ":" << occupancy.histogram[i];
+  printf(", fragmentation: %.2f\n", occupancy.fragmentation);
+}
+
+/**
+ * Compaction test of the allocator
+ * 1. allocate a bunch of memory and free most of it, leaving sparse pages
+ * 2. compact, fixing the client's pointers in the relocation callback
+ * 3. check the objects survived the move and the empty pages are released
+ * @param allocator an existing allocator to use
+ * @param numObjsToAllocate number of objects to allocate
+ */
+void compactTest(SimpleAllocator* allocator, unsigned numObjsToAllocate) {
+  try {
+    // print a title of the test
+    cout << "Running compactTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    cout << endl;
+
+    // allocate and fill the objects
+    std::vector<Person*> objects;
+    for (unsigned i = 0; i < numObjsToAllocate; i++) {
+      Person* person = static_cast<Person*>(allocator->allocate());
+      *person = PEOPLE[i % 10];
+      objects.push_back(person);
+    }
+
+    // free all but every third object
+    for (unsigned i = 0; i < numObjsToAllocate; i++) {
+      if (i % 3 != 0) {
+        allocator->free(objects[i]);
+        objects[i] = nullptr;
+      }
+    }
+    objects.erase(std::remove(objects.begin(), objects.end(), nullptr),
+                  objects.end());
+    cout << "After freeing all but every third object..." << endl;
+    printStats(allocator);
+    printOccupancy(allocator);
+    cout << endl;
+
+    // compact and release the emptied pages
+    unsigned moved = allocator->compact(relocatePerson, &objects);
+    cout << "After compact (" << moved << " objects moved)..." << endl;
+    printStats(allocator);
+    printOccupancy(allocator);
+    for (const Person* person : objects)
+      cout << person->firstName << " " << person->lastName << endl;
+    cout << endl;
+
+    // free the rest through the relocated pointers
+    for (Person* person : objects)
+      allocator->free(person);
+    cout << "After freeing the rest and freeEmptyPages ("
+         << allocator->freeEmptyPages() << " pages released)..." << endl;
+    printStats(allocator);
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Heap profiler test of the allocator
+ * 1. allocate objects under a few labels, every Nth allocation is sampled
+ * 2. free some of them and dump the profile (live and peak bytes per label)
+ * @param allocator an existing allocator to use
+ * @param numObjsToAllocate number of objects to allocate
+ */
+void profileTest(SimpleAllocator* allocator, unsigned numObjsToAllocate) {
+  try {
+    // print a title of the test
+    cout << "Running profileTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    cout << "profileSampleRate: " << allocator->getConfig().profileSampleRate
+         << endl;
+    cout << endl;
+
+    // allocate under three labels
+    const char* labels[] = {"bst-node", "avl-node", "graph-edge"};
+    std::vector<void*> objects;
+    for (unsigned i = 0; i < numObjsToAllocate; i++)
+      objects.push_back(allocator->allocate(labels[i % 3]));
+    cout << "After " << numObjsToAllocate << " allocations..." << endl;
+    allocator->dumpProfile(cout);
+    cout << endl;
+
+    // free everything but the avl nodes
+    for (unsigned i = 0; i < numObjsToAllocate; i++) {
+      if (i % 3 != 1) {
+        allocator->free(objects[i]);
+        objects[i] = nullptr;
+      }
+    }
+    cout << "After freeing the bst nodes and graph edges..." << endl;
+    allocator->dumpProfile(cout);
+    cout << endl;
+
+    for (void* object : objects)
+      allocator->free(object);
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Geometric page growth test of the allocator
+ * 1. allocate until the byte budget runs out, printing each new page
+ * 2. check handles still resolve into the grown pages
+ * @param allocator an existing allocator to use
+ */
+void growthTest(SimpleAllocator* allocator) {
+  std::vector<SimpleAllocator::Handle> handles;
+  try {
+    // print a title of the test
+    cout << "Running growthTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    SimpleAllocatorConfig config = allocator->getConfig();
+    cout << "pageGrowthFactor: " << config.pageGrowthFactor
+         << ", maxObjectsPerPage: " << config.maxObjectsPerPage
+         << ", maxBytes: " << config.maxBytes << endl;
+    cout << endl;
+
+    // allocate until the budget is used up, reporting every new page
+    unsigned pages = 0;
+    for (;;) {
+      SimpleAllocator::Handle handle = allocator->allocateHandle();
+      Person* person = static_cast<Person*>(allocator->resolve(handle));
+      *person = PEOPLE[handles.size() % 10];
+      handles.push_back(handle);
+      SimpleAllocatorStats stats = allocator->getStats();
+      if (stats.pagesInUse != pages) {
+        pages = stats.pagesInUse;
+        cout << "Object " << handles.size() << " is on new page " << pages
+             << " (pageSize: " << stats.pageSize << ")" << endl;
+      }
+    }
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+  }
+
+  cout << endl << "After " << handles.size() << " allocations..." << endl;
+  printStats(allocator);
+  const Person* last = static_cast<const Person*>(allocator->resolve(handles.back()));
+  printf("Last handle 0x%08X -> %s %s\n", handles.back(), last->firstName,
+         last->lastName);
+  for (SimpleAllocator::Handle handle : handles)
+    allocator->freeHandle(handle);
+  cout << "After " << handles.size() << " frees..." << endl;
+  printStats(allocator);
+}
+
+/**
+ * Compaction test of an allocator with geometrically grown pages
+ * 1. allocate across pages of growing capacity, with a block quarantined
+ *    when the second page is added
+ * 2. free most objects, compact and release the emptied pages
+ * 3. check the free object count still matches the pages left
+ * @param allocator an existing allocator to use
+ * @param numObjsToAllocate number of objects to allocate
+ */
+void grownCompactTest(SimpleAllocator* allocator, unsigned numObjsToAllocate) {
+  try {
+    // print a title of the test
+    cout << "Running grownCompactTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    SimpleAllocatorConfig config = allocator->getConfig();
+    cout << "pageGrowthFactor: " << config.pageGrowthFactor
+         << ", maxObjectsPerPage: " << config.maxObjectsPerPage
+         << ", quarantineBytes: " << config.quarantineBytes << endl;
+    cout << endl;
+
+    // fill the first page and quarantine one of its objects
+    std::vector<Person*> objects;
+    for (unsigned i = 0; i < config.objectsPerPage; i++) {
+      Person* person = static_cast<Person*>(allocator->allocate());
+      *person = PEOPLE[i % 10];
+      objects.push_back(person);
+    }
+    allocator->free(objects.front());
+    objects.erase(objects.begin());
+
+    // the rest go on new, bigger pages
+    for (unsigned i = objects.size() + 1; i < numObjsToAllocate; i++) {
+      Person* person = static_cast<Person*>(allocator->allocate());
+      *person = PEOPLE[i % 10];
+      objects.push_back(person);
+    }
+    cout << "After allocating " << numObjsToAllocate << " objects..." << endl;
+    printStats(allocator);
+    printOccupancy(allocator);
+    cout << endl;
+
+    // free all but every fourth object
+    for (unsigned i = 0; i < objects.size(); i++) {
+      if (i % 4 != 0) {
+        allocator->free(objects[i]);
+        objects[i] = nullptr;
+      }
+    }
+    objects.erase(std::remove(objects.begin(), objects.end(), nullptr),
+                  objects.end());
+    cout << "After freeing all but every fourth object..." << endl;
+    printStats(allocator);
+    printOccupancy(allocator);
+    cout << endl;
+
+    // compact and release the emptied pages
+    unsigned moved = allocator->compact(relocatePerson, &objects);
+    cout << "After compact (" << moved << " objects moved)..." << endl;
+    printStats(allocator);
+    printOccupancy(allocator);
+    for (const Person* person : objects)
+      cout << person->firstName << " " << person->lastName << endl;
+    cout << endl;
+
+    // every free object can be handed out again without a new page
+    SimpleAllocatorStats stats = allocator->getStats();
+    std::vector<void*> refill;
+    for (unsigned i = 0; i < stats.freeObjects; i++)
+      refill.push_back(allocator->allocate());
+    cout << "After allocating the " << refill.size() << " free objects..."
+         << endl;
+    printStats(allocator);
+    for (void* pObj : refill)
+      allocator->free(pObj);
+    for (Person* person : objects)
+      allocator->free(person);
+    cout << "After freeing everything and freeEmptyPages ("
+         << allocator->freeEmptyPages() << " pages released)..." << endl;
+    printStats(allocator);
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
+/**
+ * Shared memory budget test
+ * 1. two pools charge their pages against one byte limit
+ * 2. a pool under pressure makes the other release its empty pages
+ * 3. allocation fails once the shared limit is really used up
+ * @param limitBytes byte limit shared by the pools
+ */
+void budgetTest(size_t limitBytes) {
+  MemoryBudget budget(limitBytes);
+  SimpleAllocatorConfig config(false, 
+          4, 
+          100, 
+          SimpleAllocatorConfig::HeaderBlockInfo(SimpleAllocatorConfig::NO_HEADER), 
+          0, 
+          2,
+          true);
+  config.pBudget = &budget;
+  config.pPoolName = "tree-nodes";
+  SimpleAllocator* tree = new SimpleAllocator(sizeof(Employee), config);
+  config.pPoolName = "graph-edges";
+  SimpleAllocator* graph = new SimpleAllocator(sizeof(Employee), config);
+
+  // print a title of the test
+  cout << "Running budgetTest with: " << endl;
+
+  // print the config
+  printConfig(tree);
+  cout << endl;
+
+  std::vector<void*> treeNodes;
+  std::vector<void*> graphEdges;
+  try {
+    for (unsigned i = 0; i < 12; i++)
+      treeNodes.push_back(tree->allocate());
+    for (unsigned i = 0; i < 8; i++)
+      graphEdges.push_back(graph->allocate());
+    cout << "After 12 tree nodes and 8 graph edges..." << endl;
+    budget.dumpUsage(cout);
+    cout << endl;
+
+    // the tree's pages stay charged until someone asks for them
+    for (void* node : treeNodes)
+      tree->free(node);
+    treeNodes.clear();
+    cout << "After freeing the tree nodes..." << endl;
+    budget.dumpUsage(cout);
+    cout << endl;
+
+    for (unsigned i = 0; i < 8; i++)
+      graphEdges.push_back(graph->allocate());
+    cout << "After 8 more graph edges (the tree was shrunk)..." << endl;
+    budget.dumpUsage(cout);
+    cout << endl;
+
+    for (;;)
+      graphEdges.push_back(graph->allocate());
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+  }
+  cout << "After " << graphEdges.size() << " graph edges..." << endl;
+  budget.dumpUsage(cout);
+
+  for (void* edge : graphEdges)
+    graph->free(edge);
+  delete graph;
+  delete tree;
+}
+
+/**
+ * Run the offline analyzer on a snapshot file with one field overwritten,
+ * printing whether it was accepted, then put the field back
+ * @param path snapshot file
+ * @param field name of the field to print
+ * @param offset file offset of the field
+ * @param value value to write (its first size bytes)
+ * @param size size of the field in bytes
+ */
+void analyzeCorruptedSnapshot(const char* path, const char* field,
+                              long offset, uint64_t value, size_t size) {
+  // overwrite the field, keeping its old bytes to put back
+  FILE* file = fopen(path, "r+b");
+  char saved[8];
+  fseek(file, offset, SEEK_SET);
+  fread(saved, 1, size, file);
+  fseek(file, offset, SEEK_SET);
+  fwrite(&value, 1, size, file);
+  fclose(file);
+
+  std::ostringstream report;
+  try {
+    analyzeSnapshot(path, report);
+    cout << "Analyzer with a corrupted " << field << ": accepted" << endl;
+  } catch (const SimpleAllocatorException &e) {
+    cout << "Analyzer with a corrupted " << field << ": " << e.what() << endl;
+  }
+
+  file = fopen(path, "r+b");
+  fseek(file, offset, SEEK_SET);
+  fwrite(saved, 1, size, file);
+  fclose(file);
+}
+
+/**
+ * Snapshot test of the allocator
+ * 1. allocate labelled objects, free some of them and overrun one object
+ * 2. take a snapshot while the allocator keeps going
+ * 3. run the offline analyzer on the snapshot file
+ * 4. check the analyzer refuses the file with corrupted lengths and geometry
+ * @param allocator an existing allocator to use
+ * @param numObjsToAllocate number of objects to allocate
+ * @param path snapshot file to write (removed afterwards)
+ */
+void snapshotTest(SimpleAllocator* allocator, unsigned numObjsToAllocate,
+                  const char* path) {
+  try {
+    // print a title of the test
+    cout << "Running snapshotTest with: " << endl;
+
+    // print the config
+    printConfig(allocator);
+    cout << endl;
+
+    // allocate labelled objects and free every other one
+    const char* labels[] = {"bst-node", "graph-edge"};
+    std::vector<void*> objects;
+    for (unsigned i = 0; i < numObjsToAllocate; i++)
+      objects.push_back(allocator->allocate(labels[(i / 2) % 2]));
+    for (unsigned i = 1; i < numObjsToAllocate; i += 2) {
+      allocator->free(objects[i]);
+      objects[i] = nullptr;
+    }
+
+    // overrun the first object by one byte
+    char* overrun = static_cast<char*>(objects[0]) + allocator->getStats().objectSize;
+    char saved = *overrun;
+    *overrun = 0;
+
+    // the allocator may carry on while the child writes the file
+    int id = allocator->snapshot(path);
+    objects.push_back(allocator->allocate("after-snapshot"));
+    cout << "Snapshot " << (SimpleAllocator::waitSnapshot(id) ? "written" : "failed") << endl;
+    cout << endl;
+    analyzeSnapshot(path, cout);
+    cout << endl;
+
+    // lengths and geometry are checked against the file, not trusted
+    long firstPage = static_cast<long>(sizeof(SnapshotHeader));
+    analyzeCorruptedSnapshot(path, "page count",
+        offsetof(SnapshotHeader, pageCount), 0x00FFFFFF, sizeof(uint32_t));
+    analyzeCorruptedSnapshot(path, "block stride",
+        offsetof(SnapshotHeader, blockStride), 1, sizeof(uint64_t));
+    analyzeCorruptedSnapshot(path, "page length",
+        firstPage + offsetof(SnapshotPage, length), 1ULL << 40, sizeof(uint64_t));
+    analyzeCorruptedSnapshot(path, "page capacity",
+        firstPage + offsetof(SnapshotPage, capacity), 0xFFFF, sizeof(uint32_t));
+    remove(path);
+
+    // repair the overrun and clean up
+    *overrun = saved;
+    for (void* object : objects)
+      allocator->free(object);
+
+    // catch and act on our custom exceptions
+  } catch (const SimpleAllocatorException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during test." << endl;
+    return;
+  }
+}
+
 /**
  * Print stats about the allocator
  * @param allocator allocator to print stats about
@@ -1098,6 +2177,269 @@ int main(int argc, char *argv[]) {
     //allocFreeTest(allocator, 3, 2, true);
     cout << endl;
     break;
+  case 11: {
+    cout << "=== Test allocator" 
+         << " with guard pages" 
+         << " on 1 in 2 allocations ===" << endl;
+
+    // create the allocator
+    // - guard page settings are not part of createAllocator's params
+    SimpleAllocatorConfig config(false, 
+            4, 
+            2, 
+            SimpleAllocatorConfig::HeaderBlockInfo(SimpleAllocatorConfig::NO_HEADER), 
+            0, 
+            0,
+            true);
+    config.useGuardPages = true;
+    config.guardSampleRate = 2;
+    allocator = new SimpleAllocator(sizeof(Student), config);
+
+    // run the test
+    guardPageTest(allocator, 6);
+    cout << endl;
+    break;
+  }
+  case 12: {
+    cout << "=== Test allocator" 
+         << " with a quarantine for freed blocks" 
+         << " and a use after free ===" << endl;
+
+    // create the allocator
+    // - room for 3 student objects in quarantine
+    SimpleAllocatorConfig config(false, 
+            4, 
+            2, 
+            SimpleAllocatorConfig::HeaderBlockInfo(SimpleAllocatorConfig::BASIC_HEADER), 
+            0, 
+            0,
+            true);
+    config.quarantineBytes = 3 * sizeof(Student);
+    allocator = new SimpleAllocator(sizeof(Student), config);
+
+    // run the test
+    quarantineTest(allocator);
+    cout << endl;
+    break;
+  }
+  case 13: {
+    cout << "=== Test allocator" 
+         << " validating pad bytes" 
+         << " and freed blocks ===" << endl;
+
+    // create the allocator
+    SimpleAllocatorConfig config(false, 
+            4, 
+            2, 
+            SimpleAllocatorConfig::HeaderBlockInfo(SimpleAllocatorConfig::BASIC_HEADER), 
+            0, 
+            4,
+            true);
+    config.checkFreedBlocks = true;
+    allocator = new SimpleAllocator(sizeof(Student), config);
+
+    // run the test
+    validationTest(allocator);
+    cout << endl;
+    break;
+  }
+  case 14: {
+    cout << "=== Test shared memory allocator" 
+         << " across processes ===" << endl;
+
+    // a unique segment name so that parallel runs do not collide
+    std::string name = "/simpleallocator-test14-" + std::to_string(getpid());
+
+    // run the test
+    sharedPoolTest(name.c_str());
+    cout << endl;
+    break;
+  }
+  case 15: {
+    cout << "=== Test file-backed allocator" 
+         << " surviving a restart ===" << endl;
+
+    // a unique file name so that parallel runs do not collide
+    std::string path = "pool-test15-" + std::to_string(getpid()) + ".bin";
+
+    // run the test
+    persistentPoolTest(path.c_str());
+    cout << endl;
+    break;
+  }
+  case 16:
+    cout << "=== Test allocator" 
+         << " with handle-based allocations" 
+         << " ===" << endl;
+
+    // create the allocator
+    allocator = createAllocator(false, 
+            4, 
+            3, 
+            SimpleAllocatorConfig::BASIC_HEADER, 
+            0, 
+            2,
+            true,
+            TestObjectType::EMPLOYEE_TYPE);
+
+    // run the test
+    handleTest(allocator, 10);
+    cout << endl;
+    break;
+  case 17:
+    cout << "=== Test allocator" 
+         << " with epoch-based deferred reclamation" 
+         << " ===" << endl;
+
+    // create the allocator
+    allocator = createAllocator(false, 
+            8, 
+            200, 
+            SimpleAllocatorConfig::NO_HEADER, 
+            0, 
+            2,
+            true,
+            TestObjectType::EMPLOYEE_TYPE);
+
+    // run the test
+    epochTest(allocator, 1000);
+    cout << endl;
+    break;
+  case 18:
+    cout << "=== Test allocator" 
+         << " with compaction of sparse pages" 
+         << " ===" << endl;
+
+    // create the allocator
+    allocator = createAllocator(false, 
+            4, 
+            4, 
+            SimpleAllocatorConfig::BASIC_HEADER, 
+            0, 
+            2,
+            true,
+            TestObjectType::EMPLOYEE_TYPE);
+
+    // run the test
+    compactTest(allocator, 16);
+    cout << endl;
+    break;
+  case 19: {
+    cout << "=== Test allocator" 
+         << " with the sampling heap profiler" 
+         << " ===" << endl;
+
+    // create the allocator
+    SimpleAllocatorConfig config(false, 
+            8, 
+            8, 
+            SimpleAllocatorConfig::HeaderBlockInfo(SimpleAllocatorConfig::EXTERNAL_HEADER), 
+            0, 
+            2,
+            true);
+    config.profileSampleRate = 4;
+    allocator = new SimpleAllocator(sizeof(Student), config);
+
+    // run the test
+    profileTest(allocator, 48);
+    cout << endl;
+    break;
+  }
+  case 20: {
+    cout << "=== Test allocator" 
+         << " with geometric page growth" 
+         << " ===" << endl;
+
+    // create the allocator
+    SimpleAllocatorConfig config(false, 
+            2, 
+            10, 
+            SimpleAllocatorConfig::HeaderBlockInfo(SimpleAllocatorConfig::NO_HEADER), 
+            0, 
+            2,
+            true);
+    config.pageGrowthFactor = 2;
+    config.maxObjectsPerPage = 16;
+    config.maxBytes = 2500;
+    allocator = new SimpleAllocator(sizeof(Employee), config);
+
+    // run the test
+    growthTest(allocator);
+    cout << endl;
+    break;
+  }
+  case 21:
+    cout << "=== Test allocators" 
+         << " sharing a memory budget" 
+         << " ===" << endl;
+
+    // run the test (it creates its own allocators)
+    budgetTest(1000);
+    cout << endl;
+    break;
+  case 22: 
+  case 23: {
+    cout << "=== Test allocator" 
+         << " snapshot and offline analyzer" 
+         << (test == 22 ? " with external headers" : " with basic headers")
+         << " ===" << endl;
+
+    // create the allocator
+    allocator = createAllocator(false, 
+            4, 
+            4, 
+            test == 22 ? SimpleAllocatorConfig::EXTERNAL_HEADER
+                       : SimpleAllocatorConfig::BASIC_HEADER, 
+            0, 
+            2,
+            true,
+            TestObjectType::STUDENT_TYPE);
+
+    // a unique file name so that parallel runs do not collide
+    std::string path = "snapshot-test" + std::to_string(test) + "-" +
+                       std::to_string(getpid()) + ".bin";
+
+    // run the test
+    snapshotTest(allocator, 10, path.c_str());
+    cout << endl;
+    break;
+  }
+  case 24: {
+    cout << "=== Test allocator" 
+         << " with compaction of grown pages" 
+         << " ===" << endl;
+
+    // create the allocator
+    SimpleAllocatorConfig config(false, 
+            2, 
+            10, 
+            SimpleAllocatorConfig::HeaderBlockInfo(SimpleAllocatorConfig::BASIC_HEADER), 
+            0, 
+            2,
+            true);
+    config.pageGrowthFactor = 2;
+    config.maxObjectsPerPage = 8;
+    config.quarantineBytes = sizeof(Employee);
+    allocator = new SimpleAllocator(sizeof(Employee), config);
+
+    // run the test
+    grownCompactTest(allocator, 14);
+    cout << endl;
+    break;
+  }
+  case 25: {
+    cout << "=== Test shared memory allocator" 
+         << " with objects smaller than a link" 
+         << " ===" << endl;
+
+    // a unique segment name so that parallel runs do not collide
+    std::string name = "/simpleallocator-test25-" + std::to_string(getpid());
+
+    // run the test
+    smallObjectPoolTest(name.c_str());
+    cout << endl;
+    break;
+  }
   default:
     cout << "=== Bogus test number "<< test 
          << ", but here's some interesting info ===" << endl;